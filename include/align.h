@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <mutex>
+#include <string>
+#include <vector>
 #include "sequence.h"
 
 class Alignment
@@ -29,6 +32,11 @@ private:
 	static const int ALIGN_MISMATCH = -6;
 	static const int ALIGN_GAP_OPEN = -4;
 	static const int ALIGN_GAP_EXTEND = ALIGN_GAP_OPEN * 2;
+	// Quality weight given to N bases in quality-weighted alignments.
+	static const int N_QUALITY = 5;
+	// Affine gap scores for alignments with traceback. A gap of length k scores OPEN + k * EXTEND.
+	static const int TRACEBACK_GAP_OPEN = -8;
+	static const int TRACEBACK_GAP_EXTEND = -2;
 
 	class ScoringMatrix
 	{
@@ -65,13 +73,82 @@ public:
 		ptrdiff_t start;
 	};
 
+	enum class Mode
+	{
+		GLOBAL,      // All of the sequence range is aligned to all of the query.
+		SEMI_GLOBAL, // All of the query is aligned to any part of the sequence range.
+		LOCAL        // The best-scoring parts of each are aligned.
+	};
+
+	struct Traceback
+	{
+		int score;
+		// Aligned ranges of the sequence and query. Sequence positions are absolute.
+		size_t start;
+		size_t end;
+		size_t query_start;
+		size_t query_end;
+		// Extended CIGAR with '=' and 'X' for matched columns, 'I' for query bases and 'D' for sequence bases
+		// which are aligned to gaps.
+		std::string cigar;
+		// The aligned columns, with '-' for gaps.
+		std::string aligned_sequence;
+		std::string aligned_query;
+		// Sequence positions of mismatched columns.
+		std::vector<size_t> mismatches;
+	};
+
+	struct EditHit
+	{
+		// Position after the last sequence base of the match.
+		size_t end;
+		int errors;
+		// The match is to the reverse complement of the query.
+		bool reverse;
+	};
+
 	static bool Search(const NucleotideSequence& sequence, size_t start, size_t end, size_t max_result, const char* query, int min_percent, Result* result);
+
+	// Search every sequence for every query, as SearchByAlignmentFwd does for one sequence and query.
+	// The result for sequence i and query j is stored in results[i * query_count + j], with a start of -1 if not found.
+	// Work is spread across the shared thread pool, and short sequences are aligned in groups of LANE_COUNT.
+	static void BatchSearch(const NucleotideSequence* const* sequences, size_t sequence_count, const char* const* queries, size_t query_count, int min_percent, Result* results);
 	static bool VectorSearch5(const NucleotideSequence& sequence, const char* query, int min_percent, size_t min_match, Result* result);
 	static bool VectorSearch3(const NucleotideSequence& sequence, size_t start, const char* query, int min_percent, size_t min_match, Result* result);
 
+	// Append to hits every position in [start, end) at which a match of the query with at most max_errors
+	// substitutions, insertions and deletions ends, in order of position. IUPAC codes match as in
+	// NucleotideSequence::MatchSequence(). Takes a single pass over the range, with both strands searched together
+	// if both_strands is set, and time proportional to the range length times the number of 64-base query blocks.
+	static void EditSearch(const NucleotideSequence& sequence, size_t start, size_t end, const char* query, int max_errors, bool both_strands, std::vector<EditHit>* hits);
+
+	// Align the query to the sequence range [start, end) with affine gaps and return the full traceback.
+	// Memory use is linear in the query length for all modes. If quality_weighted is set, the score of each column
+	// is scaled by the quality of its sequence base, and gaps by the default base quality.
+	// Returns false if nothing could be aligned.
+	static bool Align(const NucleotideSequence& sequence, size_t start, size_t end, const char* query, Mode mode, bool quality_weighted, Traceback* traceback);
+
+	// As Align(), but only cells within band columns of the line joining the corners of the matrix are computed,
+	// taking O(n * band) time and memory. Whenever the path reaches the edge of the band, the band is doubled and the
+	// alignment repeated, so the score is the same as Align() gives when the optimal path lies within the band.
+	// Intended for comparing near-identical sequences such as a read and its reference.
+	static bool AlignBanded(const NucleotideSequence& sequence, size_t start, size_t end, const char* query, Mode mode, size_t band, bool quality_weighted, Traceback* traceback);
+
 private:
+	// Number of sequences aligned together by the batch search, one per lane.
+	static const size_t LANE_COUNT = 8;
+	// Sequences longer than this are searched individually because a lane group would be too unbalanced.
+	static const size_t LANE_MAX_LENGTH = 2048;
+
+	static bool SearchUninitialized(const NucleotideSequence& sequence, size_t start, size_t end, size_t max_result, const char* query, int min_percent, Result* result);
+	static void LaneSearch(const NucleotideSequence* const* sequences, size_t count, const char* query, int min_percent, Result* results, size_t result_stride);
+	// Get the scoring matrix row and score weight for each base of the sequence range.
+	static void GetSearchRows(const NucleotideSequence& sequence, size_t start, size_t end, bool quality_weighted, const int** rows, int* weights);
+
+	// Safe to call from several threads at once, as the alignment functions may be.
 	static void InitializeMatrix() {
-		matrix_.Initialize(ALIGN_MATCH, ALIGN_MISMATCH);
+		static std::once_flag initialized;
+		std::call_once(initialized, [] { matrix_.Initialize(ALIGN_MATCH, ALIGN_MISMATCH); });
 	}
 
 	static int* GetSearchMatrix(char c) {
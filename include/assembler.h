@@ -0,0 +1,114 @@
+// Assembly of overlapping reads into contigs.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "sequence.h"
+
+class Assembler
+{
+public:
+	// Length of the k-mers shared by reads which are aligned to look for an overlap.
+	static const size_t KMER_LENGTH = 12;
+
+	struct Overlap
+	{
+		// The reads, with second reverse complemented if reverse is set.
+		size_t first;
+		size_t second;
+		bool reverse;
+		// Position of the start of the oriented second read relative to the start of the first.
+		ptrdiff_t offset;
+		int score;
+		// Aligned columns, and the percentage of them which match.
+		size_t length;
+		int percent;
+	};
+
+	struct Placement
+	{
+		size_t read;
+		bool reverse;
+		// Consensus positions covered by the aligned part of the read.
+		size_t start;
+		size_t end;
+	};
+
+	struct Contig
+	{
+		std::string consensus;
+		std::vector<NucleotideSequence::quality_type> quality;
+		// In order of position.
+		std::vector<Placement> reads;
+	};
+
+	// Find the overlaps between every pair of reads, in either orientation, of at least min_overlap aligned columns
+	// of which min_percent match. Candidate pairs are found from the k-mers they share, then aligned within a band
+	// around the diagonal of the shared k-mers, in parallel on the shared thread pool. K-mers which occur in many
+	// places, such as in repeats, are not used as seeds.
+	static void FindOverlaps(const NucleotideSequence* const* reads, size_t read_count, size_t min_overlap, int min_percent, std::vector<Overlap>* overlaps);
+
+	// Assemble the reads into contigs. Overlaps are taken greedily in order of score to lay out the reads, which are
+	// then aligned in turn to the growing consensus. The consensus is called by Consensus, without the columns where
+	// a gap wins. Reads which overlap no other read become contigs of their own. Each contig is oriented so its lowest
+	// numbered read is forward.
+	static void Assemble(const NucleotideSequence* const* reads, size_t read_count, size_t min_overlap, int min_percent, std::vector<Contig>* contigs);
+
+private:
+	// K-mers occurring more often than this are skipped as seeds.
+	static const size_t MAX_KMER_OCCURRENCES = 32;
+	// Shared k-mers needed on a diagonal before a pair is aligned.
+	static const size_t MIN_SEED_HITS = 3;
+	// Width of the diagonal groups in which seeds are counted, and the band of the overlap alignment.
+	static const size_t DIAGONAL_BAND = 16;
+	// Consensus bases either side of a read's expected position which are searched when aligning it.
+	static const size_t LAYOUT_MARGIN = 64;
+	// Unaligned bases allowed at the ends of an overlap, such as poor quality read ends.
+	static const size_t MAX_OVERHANG = 50;
+
+	struct Seed
+	{
+		uint32_t kmer;
+		uint32_t read;
+		uint32_t position;
+	};
+
+	// Where a read lies in the layout of its contig.
+	struct Layout
+	{
+		size_t read;
+		bool reverse;
+		ptrdiff_t position;
+	};
+
+	// Append the k-mers of the bases, skipping any with a base other than A, C, G or T.
+	static void AddSeeds(const std::string& bases, uint32_t read, std::vector<Seed>* seeds);
+
+	// Copy the bases and quality of a read, reverse complemented if reverse is set.
+	static void Orient(const NucleotideSequence& read, bool reverse, NucleotideSequence* oriented);
+
+	// Align the oriented second read to the first about the diagonal offset and fill in the overlap if it is good enough.
+	static bool VerifyOverlap(const NucleotideSequence& first, const std::string& second, ptrdiff_t offset, size_t min_overlap, int min_percent, Overlap* overlap);
+
+	// Build the consensus of reads laid out in one contig.
+	static void BuildContig(const NucleotideSequence* const* reads, std::vector<Layout> layout, Contig* contig, std::vector<size_t>* unplaced);
+};
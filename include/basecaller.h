@@ -0,0 +1,83 @@
+// Calling bases from trace data.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "sequence.h"
+
+class BaseCaller
+{
+public:
+	// Peaks lower than this percentage of the highest sample of any channel are ignored as noise.
+	static const int MIN_PEAK_PERCENT = 5;
+	static const NucleotideSequence::quality_type MIN_QUALITY = 2;
+	static const NucleotideSequence::quality_type MAX_QUALITY = 60;
+
+	struct Peak
+	{
+		NucleotideSequence::peak_type position;
+		// Trace channel 0-3 (A, C, G, T).
+		size_t channel;
+		NucleotideSequence::trace_type height;
+	};
+
+	struct Calls
+	{
+		std::string bases;
+		std::vector<NucleotideSequence::quality_type> quality;
+		std::vector<NucleotideSequence::peak_type> peaks;
+		// Mean distance between the called peaks, as NucleotideSequence::ComputeSpacing().
+		float spacing;
+	};
+
+	// Append the local maxima of the samples of a trace channel which are at least min_height to peaks, in order of
+	// position. A flat-topped peak is placed at its first sample.
+	static void FindPeaks(const NucleotideSequence::trace_type* samples, size_t length, size_t channel, NucleotideSequence::trace_type min_height, std::vector<Peak>* peaks);
+
+	// Estimate the distance between bases as the median distance between neighbouring peaks of any channel, after
+	// merging peaks closer than two samples, then closer than half the estimate. The peaks must be in order of
+	// position. Returns 0 if there are too few.
+	static float EstimateSpacing(const std::vector<Peak>& peaks);
+
+	// Call bases from the traces of a read. One base is called per peak, keeping the highest where peaks are closer
+	// than half the spacing, and gaps of more than one and a half spacings are filled with calls from the highest
+	// channel at evenly spaced positions. Where the second highest channel reaches mixed_percent of the highest the
+	// call is the IUPAC code of both; 0 disables mixed calls. Quality is predicted phred style from the ratio of the
+	// unused channels to the call and how far the peak is from the expected spacing.
+	// Returns false if the read has no traces or too few peaks.
+	static bool Call(const NucleotideSequence& read, int mixed_percent, Calls* calls);
+
+	// Call bases as above and replace the bases, quality and peaks of the read with them, keeping its traces.
+	static bool Recall(NucleotideSequence* read, int mixed_percent);
+
+	// Recall every read, in parallel on the shared thread pool. results[i] receives the result for read i.
+	static void Recall(NucleotideSequence* const* reads, size_t read_count, int mixed_percent, bool* results);
+
+private:
+	// Trace samples either side of a call which are searched for the height of each channel.
+	static const NucleotideSequence::peak_type PEAK_HALF_WIDTH = 1;
+
+	// Merge peaks closer than min_distance into the highest of them.
+	static void MergePeaks(const std::vector<Peak>& peaks, float min_distance, std::vector<Peak>* merged);
+
+	// Call the base at a trace position from the height of each channel, and predict its quality.
+	static void CallPosition(const std::vector<NucleotideSequence::trace_type>* heights, size_t trace_length, NucleotideSequence::peak_type position, int mixed_percent, float spacing_error, char* base, NucleotideSequence::quality_type* quality);
+};
@@ -0,0 +1,84 @@
+// Codon usage and amino acid composition statistics.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include "geneticcodes.h"
+#include "sequence.h"
+
+class CodonUsage
+{
+public:
+	// Amino acid counts are indexed by LookupTables::CharIndex(), which puts stop codons at STOP_INDEX.
+	static const size_t STOP_INDEX = 26;
+	using Composition = std::array<size_t, STOP_INDEX + 1>;
+
+	struct Region
+	{
+		const NucleotideSequence* sequence;
+		size_t start;
+		size_t end;
+		bool reverse_complement;
+	};
+
+	CodonUsage()
+		: counts_() {}
+
+	// Count the complete codons of sequence[start, end), read as by GeneticCodes::Translate().
+	void Add(const NucleotideSequence& sequence, size_t start, size_t end, bool reverse_complement);
+
+	void Merge(const CodonUsage& other);
+
+	// Count the codons of all regions, dividing them between the threads of the shared pool.
+	static void Count(const std::vector<Region>& regions, CodonUsage* usage);
+
+	// All codons counted, including ambiguous ones.
+	size_t TotalCodons() const;
+
+	// Codons containing a base other than A, C, G, T or U.
+	size_t AmbiguousCodons() const;
+
+	// Count of a codon given as three bases. Ambiguous codons are counted only where they match exactly.
+	size_t CodonCount(const char* codon) const {
+		return counts_[GeneticCodes::CodonIndex(codon[0], codon[1], codon[2])];
+	}
+
+	// Amino acids coded by the counted codons. Returns false if genetic_code is not valid.
+	bool AminoAcidComposition(size_t genetic_code, Composition* composition) const;
+
+	// Fraction of codons with G or C in the third position, among those whose third base is known to be either
+	// G/C or A/T. Returns 0 if there are none.
+	double GC3() const;
+
+	// Codon adaptation index of the counted codons against the usage of reference, typically a set of highly
+	// expressed genes. Stop codons, ambiguous codons and amino acids with a single codon are excluded. Codons
+	// missing from the reference are given a count of 0.5 so that one rare codon does not make the index zero.
+	// Returns 0 if there are no codons to score or genetic_code is not valid.
+	double Cai(const CodonUsage& reference, size_t genetic_code) const;
+
+private:
+	static const size_t CODON_COUNT = 64;
+
+	// The codon index of the unambiguous codon i in TCAG order.
+	static unsigned int UnambiguousIndex(size_t i);
+
+	std::array<size_t, GeneticCodes::CODON_INDEX_COUNT> counts_;
+};
@@ -0,0 +1,110 @@
+// Quality-weighted consensus of aligned reads.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "sequence.h"
+
+// Each column of the alignment holds the total quality of the reads voting for each base and for a gap. The call is
+// the base or gap with the highest total, and its quality is that total less the total against it. The totals are
+// kept, so editing one read recomputes only the columns it covers. Like TranslationCache, it refers to the reads,
+// which must outlive it.
+class Consensus
+{
+public:
+	using quality_type = NucleotideSequence::quality_type;
+
+	static const quality_type MAX_QUALITY = 93;
+
+	// The bases of a read from column start on, with '-' for gaps, as in Alignment::Traceback::aligned_query. The
+	// bases other than gaps are those of the read, in order.
+	struct AlignedRead
+	{
+		const NucleotideSequence* read;
+		size_t start;
+		std::string aligned;
+	};
+
+	explicit Consensus(const std::vector<AlignedRead>& reads);
+
+	size_t ColumnCount() const {
+		return calls_.size();
+	}
+
+	// The call in a column, which is '-' if the gap wins, or 'N' if no read has A, C, G, T or a gap there.
+	char Call(size_t column) const;
+
+	quality_type Quality(size_t column) const {
+		return quality_[column];
+	}
+
+	// True if any read in the column has a different base or gap from the call.
+	bool IsDiscrepant(size_t column) const {
+		return against_[column] != 0;
+	}
+
+	// The consensus without the gap columns, and one bit per base, 64 to a word, set for the discrepant bases.
+	void GetSequence(NucleotideSequence* consensus, std::vector<uint64_t>* discrepancies) const;
+
+	// Add a read to the alignment, after those already in it.
+	void AddRead(const AlignedRead& aligned_read);
+
+	// Replace the alignment of read index, as after the read has been edited. Only the columns it covered before and
+	// covers now are recomputed.
+	void UpdateRead(size_t index, size_t start, const std::string& aligned);
+
+private:
+	static const size_t WORD_BITS = 64;
+	// A, C, G, T and gap.
+	static const size_t VOTE_COUNT = NucleotideSequence::TRACE_COUNT + 1;
+	static const uint8_t GAP_INDEX = 4;
+	static const uint8_t N_INDEX = 5;
+
+	// The votes of one read: what it votes for in each column from start on, N_INDEX for none, and with what quality.
+	// They are kept because an edited read no longer has the qualities it voted with.
+	struct ReadVotes
+	{
+		const NucleotideSequence* read;
+		size_t start;
+		std::vector<uint8_t> calls;
+		std::vector<int32_t> quality;
+	};
+
+	static void GetVotes(const AlignedRead& aligned_read, ReadVotes* read_votes);
+
+	// Add the votes of a read to the column totals, or take them away if sign is -1.
+	void AddVotes(const ReadVotes& read_votes, int32_t sign);
+
+	// Make room for columns up to end.
+	void Resize(size_t end);
+
+	// Recompute the calls of columns [first, last) from their totals.
+	void CallColumns(size_t first, size_t last);
+
+	std::vector<ReadVotes> reads_;
+	// Total quality voting for each of A, C, G, T and gap in each column.
+	std::vector<int32_t> votes_[VOTE_COUNT];
+	// Index of the call in "ACGT-N", its quality, and the total against it.
+	std::vector<uint8_t> calls_;
+	std::vector<quality_type> quality_;
+	std::vector<int32_t> against_;
+};
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <type_traits>
 
 #ifdef BIG_ENDIAN
 static inline uint32_t make_u32(char a, char b, char c, char d) {
@@ -88,10 +89,12 @@ inline unsigned int system_endian(int val)
 template<typename T>
 T read_bigendian(const char* src, size_t size)
 {
-    T value = src[0];
+    // The first byte is sign extended. Shifting is done unsigned, as shifting a negative value is undefined.
+    using U = typename std::make_unsigned<T>::type;
+    U value = U(T(src[0]));
     for (size_t i = 1; i < size; ++i)
-        value = (value << 8) + uint8_t(src[i]);
-    return value;
+        value = U(value << 8) | uint8_t(src[i]);
+    return T(value);
 }
 
 template<typename T>
@@ -21,7 +21,10 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "lookuptables.h"
@@ -39,14 +42,54 @@ private:
 	// Lookup table size is 1 bit per base for 3 bases
 	static const size_t TABLE_SIZE = 1 << (4 * 3);
 
+	static const size_t CODON_COUNT = 64;
+
 	struct CodonTable
 	{
 		std::string name;
+		// The unambiguous codons in TCAG order, from which table is built on first use.
+		std::array<Codon, CODON_COUNT> codons;
 		std::array<Codon, TABLE_SIZE> table;
+		// The amino acids of table, packed for bulk translation.
+		std::array<char, TABLE_SIZE> amino_acids;
+		// Set once table and amino_acids are built, so later lookups skip expand_once.
+		std::atomic<bool> expanded;
+		std::once_flag expand_once;
+
+		CodonTable(const char* name, const Codon* codons);
 
+		// Parse a line of the genetic code file.
 		CodonTable(const char* line);
+
+		void Expand();
+	};
+
+	struct Registry
+	{
+		// Loads the genetic code file if there is one, otherwise the built-in tables.
+		Registry();
+
+		std::vector<std::unique_ptr<CodonTable>> codon_tables;
 	};
 
+	// The tables are loaded on first use, so programs which never translate do no I/O.
+	static const std::vector<std::unique_ptr<CodonTable>>& Tables() {
+		static Registry registry;
+		return registry.codon_tables;
+	}
+
+	// A table of Tables(), which is expanded the first time its code is used. After that, this costs only a load of
+	// the expanded flag.
+	static const CodonTable& ExpandedTable(CodonTable& table) {
+		if (!table.expanded.load(std::memory_order_acquire)) {
+			std::call_once(table.expand_once, [&table] {
+				table.Expand();
+				table.expanded.store(true, std::memory_order_release);
+			});
+		}
+		return table;
+	}
+
 public:
 	static const int STANDARD = 0;
 	static const char AA_D_OR_N = 'B';
@@ -61,15 +104,15 @@ public:
 		using reference_type = const value_type&;
 
 	public:
-		Iterator(std::vector<CodonTable>::const_iterator it)
+		Iterator(std::vector<std::unique_ptr<CodonTable>>::const_iterator it)
 			: iterator_(it) {}
 
 		reference_type operator*() const {
-			return iterator_->name;
+			return (*iterator_)->name;
 		}
 
 		pointer_type operator->() const {
-			return &iterator_->name;
+			return &(*iterator_)->name;
 		}
 
 		Iterator& operator++() {
@@ -92,50 +135,67 @@ public:
 		}
 
 	private:
-		std::vector<CodonTable>::const_iterator iterator_;
+		std::vector<std::unique_ptr<CodonTable>>::const_iterator iterator_;
 	};
 
 	static Iterator cbegin() {
-		return Iterator(impl_.codon_tables.cbegin());
+		return Iterator(Tables().cbegin());
 	}
 
 	static Iterator cend() {
-		return Iterator(impl_.codon_tables.cend());
+		return Iterator(Tables().cend());
 	}
 
 	static int Search(const char* name);
 
 	static Codon TranslateForward(const char* sequence, size_t pos, size_t length, size_t genetic_code)	{
-		assert(genetic_code < impl_.codon_tables.size());
+		const auto& tables = Tables();
+		assert(genetic_code < tables.size());
 
-		if (genetic_code >= impl_.codon_tables.size() || pos + 3 > length)
+		if (genetic_code >= tables.size() || pos + 3 > length)
 			return { AA_UNKNOWN, false };
 
 		unsigned int i = LookupTables::BaseFlags(sequence[pos + 2])
 			+ (LookupTables::BaseFlags(sequence[pos + 1]) << 4)
 			+ (LookupTables::BaseFlags(sequence[pos]) << 8);
-		return impl_.codon_tables[genetic_code].table[i];
+		return ExpandedTable(*tables[genetic_code]).table[i];
 	}
 
 	static Codon TranslateReverseComplement(const char* sequence, size_t pos, size_t length, size_t genetic_code) {
-		assert(genetic_code < impl_.codon_tables.size());
+		const auto& tables = Tables();
+		assert(genetic_code < tables.size());
 
-		if (genetic_code >= impl_.codon_tables.size() || pos + 3 > length)
+		if (genetic_code >= tables.size() || pos + 3 > length)
 			return { AA_UNKNOWN, false };
 
 		unsigned int i = LookupTables::BaseFlagsComplement(sequence[pos])
 			+ (LookupTables::BaseFlagsComplement(sequence[pos + 1]) << 4)
 			+ (LookupTables::BaseFlagsComplement(sequence[pos + 2]) << 8);
-		return impl_.codon_tables[genetic_code].table[i];
+		return ExpandedTable(*tables[genetic_code]).table[i];
+	}
+
+	// Translate every complete codon of sequence[start, end) into amino_acids and return the number translated.
+	// Forward codons begin at start; reverse complement codons begin at end and are read towards start.
+	static size_t Translate(const char* sequence, size_t start, size_t end, bool reverse_complement, size_t genetic_code, char* amino_acids);
+
+	// As Translate(), but with the start codon flag of each codon too.
+	static size_t TranslateCodons(const char* sequence, size_t start, size_t end, bool reverse_complement, size_t genetic_code, Codon* codons);
+
+	// Number of 12-bit codon indexes, made of the base flags of the first, second and third bases in bits 8, 4 and 0.
+	static const size_t CODON_INDEX_COUNT = TABLE_SIZE;
+
+	static unsigned int CodonIndex(char first, char second, char third) {
+		return LookupTables::BaseFlags(third) | (LookupTables::BaseFlags(second) << 4) | (LookupTables::BaseFlags(first) << 8);
 	}
 
+	// The amino acid for every codon index, or nullptr if genetic_code is not valid.
+	static const char* AminoAcidTable(size_t genetic_code);
+
 private:
-	static struct static_initializer
-	{
-		static_initializer() { Initialize(); }
-		// If the vector was a static member of GeneticCodes it could be constructed after this object.
-		std::vector<CodonTable> codon_tables;
-	} impl_;
+	// Codons translated together by Translate(), small enough for the index buffer to stay in L1 cache.
+	static const size_t TRANSLATE_BLOCK = 1024;
+
+	template<typename T>
+	static void TranslateBlocks(const char* sequence, size_t start, size_t end, bool reverse_complement, const T* table, T* out);
 
-	static void Initialize();
 };
\ No newline at end of file
@@ -0,0 +1,79 @@
+// K-mer sketches of sequences for fast similarity estimates.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "sequence.h"
+
+// A sample of the hashes of the canonical k-mers of a sequence: either the lowest sketch_size hashes (MinHash) or
+// every hash below 2^64 / scale (FracMinHash). Two sketches are compared over the hashes below the lower of their
+// limits, which gives an estimate of the Jaccard similarity and containment of their k-mer sets without aligning.
+class KmerSketch
+{
+public:
+	static const size_t MAX_KMER_LENGTH = 32;
+	static const size_t NOT_FOUND = NucleotideSequence::NOT_FOUND;
+
+	// An empty sketch, which matches nothing.
+	KmerSketch();
+
+	// Append the canonical k-mers of a sequence, each the lower of the k-mer and its reverse complement in two bits
+	// per base, A=0 C=1 G=2 T=3. K-mers with any base other than A, C, G or T are skipped. kmer_length is at most 32.
+	static void CanonicalKmers(const NucleotideSequence& sequence, size_t kmer_length, std::vector<uint64_t>* kmers);
+
+	// Invertible mix of the bits of a k-mer, so that the lowest hashes are a random sample of the k-mers.
+	static uint64_t Hash(uint64_t kmer);
+
+	void BuildMinHash(const NucleotideSequence& sequence, size_t kmer_length, size_t sketch_size);
+
+	void BuildFracMinHash(const NucleotideSequence& sequence, size_t kmer_length, uint64_t scale);
+
+	// The distinct hashes in the sketch, in increasing order.
+	const std::vector<uint64_t>& Hashes() const {
+		return hashes_;
+	}
+
+	// Estimated Jaccard similarity of the k-mer sets of the two sequences.
+	double Jaccard(const KmerSketch& other) const;
+
+	// Estimated fraction of the k-mers of this sequence which are in the other.
+	double Containment(const KmerSketch& other) const;
+
+	// For each read, the reference containing the most of its k-mers, or NOT_FOUND if none contains min_containment.
+	// Only references sharing a hash with a read are compared, and reads are assigned in parallel.
+	static void Assign(const KmerSketch* reads, size_t read_count, const KmerSketch* references, size_t reference_count, double min_containment, std::vector<size_t>* assignments);
+
+	// Group sketches greedily: each joins the most similar cluster whose first member it matches with at least
+	// min_jaccard, or starts a new cluster. Clusters are numbered in order of their first member.
+	static void Cluster(const KmerSketch* sketches, size_t count, double min_jaccard, std::vector<size_t>* clusters);
+
+private:
+	// Count the hashes of each sketch below the lower limit of the two, and those in both.
+	void Compare(const KmerSketch& other, size_t* own_count, size_t* other_count, size_t* shared_count) const;
+
+	// Hashes of the sequence's k-mers, sorted, without duplicates.
+	static void HashKmers(const NucleotideSequence& sequence, size_t kmer_length, std::vector<uint64_t>* hashes);
+
+	size_t kmer_length_;
+	// Every hash of the sequence at or below the limit is in the sketch.
+	uint64_t limit_;
+	std::vector<uint64_t> hashes_;
+};
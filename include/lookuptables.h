@@ -20,68 +20,236 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+// Fixed-size table which, unlike std::array before C++17, can be filled in a constexpr function.
+template<typename T, size_t N>
+struct ConstTable
+{
+	T values[N];
+
+	constexpr T operator[](size_t i) const {
+		return values[i];
+	}
+
+	constexpr size_t size() const {
+		return N;
+	}
+};
+
+// Builds the tables of LookupTables at compile time.
+class LookupTableBuilder
+{
+public:
+	static const uint8_t CHAR_UNKNOWN = 26;
+
+	using ByteTable = ConstTable<uint8_t, 256>;
+	using CodeTable = ConstTable<int8_t, 256>;
+	using CharTable = ConstTable<char, 256>;
+	using AminoAcidTable = ConstTable<uint32_t, CHAR_UNKNOWN + 1>;
+
+	static constexpr CharTable Uppercase() {
+		CharTable table = {};
+		for (size_t i = 0; i < 256; ++i)
+			table.values[i] = char(i >= 'a' && i <= 'z' ? i - 'a' + 'A' : i);
+		return table;
+	}
+
+	static constexpr CharTable Lowercase() {
+		CharTable table = {};
+		for (size_t i = 0; i < 256; ++i)
+			table.values[i] = char(i >= 'A' && i <= 'Z' ? i - 'A' + 'a' : i);
+		return table;
+	}
+
+	static constexpr ByteTable CharIndex() {
+		ByteTable table = {};
+		for (size_t i = 0; i < 256; ++i)
+			table.values[i] = i >= 'A' && i <= 'Z' ? uint8_t(i - 'A') : i >= 'a' && i <= 'z' ? uint8_t(i - 'a') : CHAR_UNKNOWN;
+		return table;
+	}
+
+	// Complement is undefined for invalid nucleotide codes so leave them unchanged.
+	static constexpr CharTable Complement() {
+		//                                     ABCDEFGHIJKLMNOPQRSTUVWXYZ
+		const char* alphabetic_complement = "TVGHEFCDIJMLKNOPQYSAABWXRZ";
+		CharTable table = {};
+		for (size_t i = 0; i < 256; ++i) {
+			if (i >= 'A' && i <= 'Z')
+				table.values[i] = alphabetic_complement[i - 'A'];
+			else if (i >= 'a' && i <= 'z')
+				table.values[i] = char(alphabetic_complement[i - 'a'] - 'A' + 'a');
+			else
+				table.values[i] = char(i);
+		}
+		return table;
+	}
+
+	// One bit per base, in the order T, C, A, G.
+	template<size_t N>
+	static constexpr ByteTable BaseFlags(const std::array<const char*, N>& iupac_codes) {
+		ByteTable table = {};
+		for (size_t i = 0; i < N; ++i) {
+			uint8_t flags = 0;
+			for (const char* p = iupac_codes[i] + 2; *p; ++p)
+				flags |= BaseFlag(*p);
+			SetBothCases(table, iupac_codes[i][0], flags);
+		}
+		SetBothCases(table, 'U', BaseFlag('T'));
+		return table;
+	}
+
+	// Two bit code of each unambiguous base, A=0 C=1 G=2 T=3, or -1.
+	static constexpr CodeTable BaseCodes() {
+		const char* bases = "ACGT";
+		CodeTable table = {};
+		for (size_t i = 0; i < 256; ++i)
+			table.values[i] = -1;
+		for (int8_t code = 0; code < 4; ++code) {
+			table.values[(unsigned char)bases[code]] = code;
+			table.values[(unsigned char)(bases[code] - 'A' + 'a')] = code;
+		}
+		table.values['U'] = table.values['u'] = 3;
+		return table;
+	}
+
+	template<size_t N>
+	static constexpr ByteTable IupacIndex(const std::array<const char*, N>& iupac_codes, uint8_t undefined_index) {
+		ByteTable table = {};
+		for (size_t i = 0; i < 256; ++i)
+			table.values[i] = undefined_index;
+		for (size_t i = 0; i < N; ++i) {
+			SetBothCases(table, iupac_codes[i][0], uint8_t(i));
+			if (iupac_codes[i][0] == 'T')
+				SetBothCases(table, 'U', uint8_t(i));
+		}
+		return table;
+	}
+
+	// For each amino acid code, a bit for itself and for each amino acid it may stand for.
+	static constexpr AminoAcidTable AminoAcidRedundantMatrix() {
+		const char* aa_iupac_codes[] = {
+			"B:DN",
+			"X:ACDEFGHIKLMNPQRSTVWY",
+			"Z:EQ"
+		};
+		AminoAcidTable table = {};
+		for (size_t i = 0; i < CHAR_UNKNOWN; ++i)
+			table.values[i] = 1u << i;
+		for (const char* code : aa_iupac_codes) {
+			for (const char* p = code + 2; *p; ++p)
+				table.values[code[0] - 'A'] |= 1u << (*p - 'A');
+		}
+		table.values[CHAR_UNKNOWN] = 0;
+		return table;
+	}
+
+private:
+	static constexpr uint8_t BaseFlag(char base) {
+		return base == 'T' ? 1 : base == 'C' ? 2 : base == 'A' ? 4 : base == 'G' ? 8 : 0;
+	}
+
+	static constexpr void SetBothCases(ByteTable& table, char c, uint8_t value) {
+		table.values[(unsigned char)c] = value;
+		table.values[(unsigned char)(c - 'A' + 'a')] = value;
+	}
+};
+
 class LookupTables
 {
 public:
 	static const size_t IUPAC_UNDEFINED_INDEX = 15;
 
-	static const std::array<const std::string, 15> iupac_codes;
-
-	static inline char Uppercase(char base) {
+	static constexpr std::array<const char*, 15> iupac_codes = { {
+		"A:A",
+		"B:CGT",
+		"C:C",
+		"D:AGT",
+		"G:G",
+		"H:ACT",
+		"K:GT",
+		"M:AC",
+		"N:ACGT",
+		"R:AG",
+		"S:CG",
+		"T:T",
+		"V:ACG",
+		"W:AT",
+		"Y:CT"
+	} };
+
+	static constexpr char Uppercase(char base) {
 		return uppercase[(unsigned char)base];
 	}
 
-	static inline char Lowercase(char base) {
+	static constexpr char Lowercase(char base) {
 		return lowercase[(unsigned char)base];
 	}
 
-	static inline uint8_t CharIndex(char base) {
+	static constexpr uint8_t CharIndex(char base) {
 		return char_index[(unsigned char)base];
 	}
 
-	static inline uint8_t IupacIndex(char base) {
+	static constexpr uint8_t IupacIndex(char base) {
 		return iupac_index[(unsigned char)base];
 	}
 
-	static inline char Complement(char base) {
+	static constexpr char Complement(char base) {
 		return complement[(unsigned char)base];
 	}
 
-	static inline uint8_t BaseFlags(char base) {
+	static constexpr uint8_t BaseFlags(char base) {
 		return base_flags[(unsigned char)base];
 	}
 
-	static inline uint8_t BaseFlagsComplement(char base) {
+	static constexpr uint8_t BaseFlagsComplement(char base) {
 		return base_flags[(unsigned char)complement[(unsigned char)base]];
 	}
 
-	static inline bool BaseMatch(char base, char query) {
+	// Two bit code of an unambiguous base, A=0 C=1 G=2 T=3, which is also its trace channel, or -1 for any other code.
+	static constexpr int BaseCode(char base) {
+		return base_codes[(unsigned char)base];
+	}
+
+	// The IUPAC code standing for two bases given by their two bit codes, as from BaseCode().
+	static constexpr char TwoBaseCode(int first, int second) {
+		uint8_t flags = BaseFlags("ACGT"[first]) | BaseFlags("ACGT"[second]);
+		for (size_t i = 0; i < iupac_codes.size(); ++i) {
+			if (BaseFlags(iupac_codes[i][0]) == flags)
+				return iupac_codes[i][0];
+		}
+		return 'N';
+	}
+
+	// The reverse complement of a string of bases, as for a read on the other strand.
+	static std::string ReverseComplement(const std::string& bases) {
+		std::string complement(bases.rbegin(), bases.rend());
+		for (auto& base : complement)
+			base = Complement(base);
+		return complement;
+	}
+
+	static constexpr bool BaseMatch(char base, char query) {
 		return (BaseFlags(base) & BaseFlags(query)) == BaseFlags(base);
 	}
 
-	static inline bool AminoAcidMatch(char base, char query) {
+	static constexpr bool AminoAcidMatch(char base, char query) {
 		// CharIndex() can't handle the stop codon '*' so test identity too.
 		return base == query || (amino_acid_redundant_matrix[CharIndex(base)] & (1u << CharIndex(query))) != 0;
 	}
 
 private:
-	static class static_initializer
-	{
-	public:
-		static_initializer() { Initialize(); }
-	} initializer_;
-
-	static void Initialize();
-
-	static const char CHAR_UNKNOWN = 26;
-
-	static std::array<char, 256> uppercase, lowercase;
-	static std::array<uint8_t, 256> char_index;
-	static std::array<uint8_t, 256> iupac_index;
-	static std::array<char, 256> complement;
-	static std::array<uint8_t, 256> base_flags;
-	static std::array<uint32_t, CHAR_UNKNOWN + 1> amino_acid_redundant_matrix;
+	static const uint8_t CHAR_UNKNOWN = LookupTableBuilder::CHAR_UNKNOWN;
+
+	// All tables are constant data, so they are usable during static initialization and in constant expressions.
+	static constexpr LookupTableBuilder::CharTable uppercase = LookupTableBuilder::Uppercase();
+	static constexpr LookupTableBuilder::CharTable lowercase = LookupTableBuilder::Lowercase();
+	static constexpr LookupTableBuilder::ByteTable char_index = LookupTableBuilder::CharIndex();
+	static constexpr LookupTableBuilder::ByteTable iupac_index = LookupTableBuilder::IupacIndex(iupac_codes, IUPAC_UNDEFINED_INDEX);
+	static constexpr LookupTableBuilder::CharTable complement = LookupTableBuilder::Complement();
+	static constexpr LookupTableBuilder::ByteTable base_flags = LookupTableBuilder::BaseFlags(iupac_codes);
+	static constexpr LookupTableBuilder::CodeTable base_codes = LookupTableBuilder::BaseCodes();
+	static constexpr LookupTableBuilder::AminoAcidTable amino_acid_redundant_matrix = LookupTableBuilder::AminoAcidRedundantMatrix();
 };
-
@@ -0,0 +1,62 @@
+// Open reading frame detection.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include "sequence.h"
+
+class OrfFinder
+{
+public:
+	struct Orf
+	{
+		// Bases of the ORF including the start and stop codons. On the reverse strand the start codon is at the end.
+		size_t start;
+		size_t end;
+		bool reverse;
+	};
+
+	// Find the open reading frames in all six frames and return them in orfs, ordered by start position.
+	// Each stop codon ends at most one ORF, which begins at the first start codon after the previous stop in the
+	// same frame, and must have at least min_codons codons before the stop. If alternative_starts is set, any codon
+	// the genetic code allows to start translation is used, otherwise only those coding for methionine.
+	// Large sequences are divided into chunks which are scanned in parallel on the shared thread pool.
+	static void Find(const NucleotideSequence& sequence, size_t genetic_code, size_t min_codons, bool alternative_starts, std::vector<Orf>* orfs);
+
+private:
+	static const size_t NONE = (size_t)-1;
+
+	// Codons per chunk. Chunks never split a codon, so they need no overlap.
+	static const size_t CHUNK_CODONS = 1 << 16;
+
+	// Codon indexes of a chunk are counted in reading order from the start of its frame.
+	struct Chunk
+	{
+		size_t first_stop;
+		// The first start codon before first_stop.
+		size_t first_start;
+		// The first start codon after the last stop, or anywhere in the chunk if it has no stop.
+		size_t open_start;
+		// ORFs with both codons inside the chunk, as pairs of start and stop codon.
+		std::vector<std::pair<size_t, size_t>> orfs;
+	};
+
+	static void ScanChunk(const NucleotideSequence& sequence, size_t genetic_code, bool alternative_starts, size_t frame, bool reverse, size_t first, size_t last, Chunk* chunk);
+};
@@ -0,0 +1,83 @@
+// Index of the trace peaks of a sequence for finding the bases at trace samples.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "sequence.h"
+
+// A tree over the bases holding the lowest and highest peak of each range of bases. Searches skip every range whose
+// peaks can't match, which leaves O(log n) ranges to visit where the peaks increase along the sequence, as they do
+// apart from short runs after edits. Like TranslationCache, it refers to the sequence and must be told of edits.
+class PeakIndex
+{
+public:
+	using peak_type = NucleotideSequence::peak_type;
+
+	static const size_t NOT_FOUND = NucleotideSequence::NOT_FOUND;
+
+	explicit PeakIndex(const NucleotideSequence& sequence);
+
+	// The base whose peak is closest to sample, the first if several are as close. NOT_FOUND without peaks. Bases
+	// beyond the last peak of a read with fewer peaks than bases are never found.
+	size_t NearestBase(peak_type sample) const;
+
+	// Find the first and last bases with a peak in samples [start, end). Where peaks are out of order, bases between
+	// them may have peaks outside the window. Returns false if no peak is in the window.
+	bool BasesInWindow(peak_type start, peak_type end, size_t* first_base, size_t* last_base) const;
+
+	// Update the index after bases [pos, pos + old_length) of the sequence have been replaced by new_length bases, as
+	// by NucleotideSequence::Replace() or DeleteSubsequence(). Substitutions update only the ranges containing them;
+	// other edits update the ranges from pos to the end, whose bases have moved.
+	void Update(size_t pos, size_t old_length, size_t new_length);
+
+	// Index every peak again, as after NucleotideSequence::ReverseComplement().
+	void Refresh();
+
+private:
+	// Bases with a peak: every base, unless the read has fewer peaks than bases.
+	size_t PeakCount() const;
+
+	// Leaves of the tree, hold the peaks of bases [first, last), or no peak beyond the end of the sequence.
+	void SetLeaves(size_t first, size_t last);
+
+	// Recompute the ranges above leaves [first, last).
+	void UpdateParents(size_t first, size_t last);
+
+	// Distance from sample to the nearest peak a node could hold.
+	int64_t LowerBound(size_t node, peak_type sample) const;
+
+	void Nearest(size_t node, peak_type sample, size_t* base, int64_t* distance) const;
+
+	// The first or last base under node with a peak in [start, end), or NOT_FOUND.
+	size_t FindFirst(size_t node, peak_type start, peak_type end) const;
+	size_t FindLast(size_t node, peak_type start, peak_type end) const;
+
+	bool Overlaps(size_t node, peak_type start, peak_type end) const {
+		return lowest_[node] < end && highest_[node] >= start;
+	}
+
+	const NucleotideSequence& sequence_;
+	size_t length_;
+	// Number of leaves, a power of two. Node 1 is the root and node i has children 2i and 2i + 1.
+	size_t leaf_count_;
+	std::vector<peak_type> lowest_;
+	std::vector<peak_type> highest_;
+};
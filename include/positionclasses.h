@@ -0,0 +1,90 @@
+// Bitmaps of the positions of a sequence which need attention.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "sequence.h"
+
+// One bit per base for each class of position, so that the next position of any combination of classes is found
+// a machine word at a time. Like TranslationCache, it refers to the sequence and must be told of edits.
+class PositionClasses
+{
+public:
+	// Classes of position, which may be combined to search for any of them.
+	static const unsigned int N = 1;
+	// Any IUPAC code standing for more than one base, as NucleotideSequence::IsRedundant(). Includes N.
+	static const unsigned int REDUNDANT = 2;
+	// Bases with a recorded quality below the low quality threshold.
+	static const unsigned int LOW_QUALITY = 4;
+	// Bases inserted or replaced through Update().
+	static const unsigned int EDITED = 8;
+
+	static const size_t NOT_FOUND = NucleotideSequence::NOT_FOUND;
+
+	PositionClasses(const NucleotideSequence& sequence, int low_quality);
+
+	// True if the base at pos is in any of the classes.
+	bool Is(size_t pos, unsigned int classes) const;
+
+	// The first position at or after start_pos in any of the classes.
+	size_t FindNext(size_t start_pos, unsigned int classes) const;
+
+	// The last position before end_pos in any of the classes.
+	size_t FindPrevious(size_t end_pos, unsigned int classes) const;
+
+	// Update the bitmaps after bases [pos, pos + old_length) of the sequence have been replaced by new_length bases,
+	// as by NucleotideSequence::Replace() or DeleteSubsequence(). The new bases are classified and marked as edited.
+	void Update(size_t pos, size_t old_length, size_t new_length);
+
+	// Classify every base again, as after NucleotideSequence::ReverseComplement(). Edit marks are cleared.
+	void Refresh();
+
+	void SetLowQuality(int low_quality);
+
+	void ClearEdited();
+
+private:
+	static const size_t CLASS_COUNT = 4;
+	static const size_t WORD_BITS = 64;
+
+	enum ClassIndex
+	{
+		N_INDEX,
+		REDUNDANT_INDEX,
+		LOW_QUALITY_INDEX,
+		EDITED_INDEX
+	};
+
+	static size_t WordCount(size_t length) {
+		return (length + WORD_BITS - 1) / WORD_BITS;
+	}
+
+	// Set the class bits of bases [start, end) of the sequence, except for edit marks.
+	void Classify(size_t start, size_t end);
+
+	// The bits of word i of every class in classes, combined.
+	uint64_t Word(size_t i, unsigned int classes) const;
+
+	const NucleotideSequence& sequence_;
+	int low_quality_;
+	size_t length_;
+	std::vector<uint64_t> bits_[CLASS_COUNT];
+};
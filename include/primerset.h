@@ -0,0 +1,122 @@
+// A set of primers and adapters compiled for searching reads.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "sequence.h"
+
+// Every primer and its reverse complement are indexed once by their short exact seeds, with IUPAC codes expanded, in a
+// table addressed by the 2-bit code of the seed. A read is then searched for the whole set in one pass: each seed in
+// the read gives candidate primer positions, which are checked for substitutions. The seed length is chosen so that
+// any match with up to max_mismatches substitutions contains an exact seed, as long as primers are long enough for
+// seeds of MIN_SEED_LENGTH. Primers too degenerate to index, with a seed standing for more than MAX_SEED_EXPANSIONS
+// sequences, are compared at every read position instead. The compiled set can be saved to a cache file and loaded
+// without compiling again.
+class PrimerSet
+{
+public:
+	// Which way round a primer is expected in a read: as given, reverse complemented, or either way.
+	enum class Orientation : uint8_t
+	{
+		FORWARD,
+		REVERSE,
+		EITHER
+	};
+
+	struct Primer
+	{
+		std::string name;
+		// May contain IUPAC codes.
+		std::string bases;
+		Orientation orientation;
+	};
+
+	struct Hit
+	{
+		size_t primer;
+		// Position of the first read base of the match.
+		size_t start;
+		// The read matches the reverse complement of the primer.
+		bool reverse;
+		// The match is in the primer's expected orientation.
+		bool expected;
+		int mismatches;
+	};
+
+	PrimerSet();
+
+	// Add a primer, which is searched for after the next Compile().
+	void Add(const std::string& name, const std::string& bases, Orientation orientation);
+
+	size_t Count() const {
+		return primers_.size();
+	}
+
+	const Primer& GetPrimer(size_t i) const {
+		return primers_[i];
+	}
+
+	// Build the seed table for finding matches with at most max_mismatches substitutions.
+	void Compile(int max_mismatches);
+
+	// Find every match of every primer in the read on either strand, in order of start then primer. A read base
+	// matches a primer code which includes it, as in NucleotideSequence::MatchSequence(), so an N in the read is
+	// a mismatch. Only matches lying wholly in the read are found.
+	void Classify(const NucleotideSequence& read, std::vector<Hit>* hits) const;
+
+	// Write the primers and the compiled table to a cache file, in the byte order of this machine.
+	void Save(const char* path) const;
+
+	// Replace the primers and table with those of a cache file written by Save(). Throws invalid_file_format if the
+	// file isn't a valid cache.
+	void Load(const char* path);
+
+private:
+	static const size_t MIN_SEED_LENGTH = 4;
+	static const size_t MAX_SEED_LENGTH = 10;
+	// Seeds standing for more sequences than this, through IUPAC codes, are too many to index.
+	static const size_t MAX_SEED_EXPANSIONS = 16;
+	static const uint32_t FILE_VERSION = 2;
+
+	// A seed at offset in pattern, which is 2i for primer i and 2i + 1 for its reverse complement.
+	struct Seed
+	{
+		uint32_t pattern;
+		uint32_t offset;
+	};
+
+	// The primers and their reverse complements, in pattern order.
+	void BuildPatterns();
+
+	// Substitutions in the match of a pattern at start of the read, or more than max_mismatches_ if there are more.
+	int CountMismatches(const NucleotideSequence& read, size_t start, const std::string& pattern) const;
+
+	std::vector<Primer> primers_;
+	std::vector<std::string> patterns_;
+	int max_mismatches_;
+	size_t seed_length_;
+	// The seeds with code c are seeds_[seed_starts_[c]] up to seeds_[seed_starts_[c + 1]]. Empty until compiled.
+	std::vector<uint32_t> seed_starts_;
+	std::vector<Seed> seeds_;
+	// Patterns with no seeds in the table, which are compared at every position.
+	std::vector<uint32_t> scanned_;
+};
@@ -0,0 +1,101 @@
+// Quality control reports for runs of sequencing traces.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "sequence.h"
+
+class QcReport
+{
+public:
+	// Bases with at least this quality are counted in good_quality_bases.
+	static const NucleotideSequence::quality_type GOOD_QUALITY = 20;
+
+	struct ReadMetrics
+	{
+		std::string path;
+		// The container name, well and capillary recorded in an ab1 file. Empty or 0 if not recorded.
+		std::string plate;
+		std::string well;
+		int capillary;
+		// Why the file could not be loaded, or empty if it was.
+		std::string error;
+		size_t length;
+		size_t good_quality_bases;
+		// Length of the region found by QualityTrim::WindowStart() and WindowEnd(), or 0 if there is none.
+		size_t trimmed_length;
+		float percent_gc;
+		// Mean height of the called base's trace channel at its peak, or 0 without traces.
+		float signal;
+		// As NucleotideSequence::ComputeSpacing().
+		float spacing;
+	};
+
+	struct Summary
+	{
+		std::string plate;
+		// 0 when summarizing by plate only.
+		int capillary;
+		size_t reads;
+		size_t failed;
+		// Means over the reads which were loaded.
+		double length;
+		double good_quality_bases;
+		double trimmed_length;
+		double percent_gc;
+		double signal;
+		double spacing;
+	};
+
+	// Compute the metrics of a read. All but the trimmed length are gathered in a single pass over the bases.
+	static void Measure(const NucleotideSequence& read, unsigned int trim_window, int trim_quality, ReadMetrics* metrics);
+
+	// Load an ab1 or SCF file, chosen by the file extension, and record its path and run details in metrics.
+	// Returns false with metrics->error set if the file can't be loaded.
+	static bool Load(const char* path, NucleotideSequence* read, ReadMetrics* metrics);
+
+	// Append the paths of the ab1 and SCF files in a directory to paths, sorted by name.
+	// Returns false if the directory can't be read.
+	static bool FindTraceFiles(const char* directory, std::vector<std::string>* paths);
+
+	// Load and measure every file, in parallel on the shared thread pool. Metrics are stored in the order of paths,
+	// and files which can't be loaded are recorded with their error rather than stopping the run.
+	static void Run(const std::vector<std::string>& paths, unsigned int trim_window, int trim_quality, std::vector<ReadMetrics>* reads);
+
+	// Summarize the reads of each plate, or of each capillary of each plate if by_capillary is set.
+	// Summaries are ordered by plate and capillary.
+	static void Summarize(const std::vector<ReadMetrics>& reads, bool by_capillary, std::vector<Summary>* summaries);
+
+	// Write one line per read or summary, with a header line.
+	static void WriteCsv(std::ostream& stream, const std::vector<ReadMetrics>& reads);
+	static void WriteCsv(std::ostream& stream, const std::vector<Summary>& summaries);
+
+	// Write an object with "reads" and "summaries" arrays.
+	static void WriteJson(std::ostream& stream, const std::vector<ReadMetrics>& reads, const std::vector<Summary>& summaries);
+
+private:
+	static bool LoadAb1(const char* path, NucleotideSequence* read, ReadMetrics* metrics);
+	static bool LoadScf(const char* path, NucleotideSequence* read, ReadMetrics* metrics);
+
+	static void WriteCsvField(std::ostream& stream, const std::string& field);
+	static void WriteJsonString(std::ostream& stream, const std::string& value);
+};
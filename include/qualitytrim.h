@@ -0,0 +1,79 @@
+// Quality trimming of sequencing reads.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include "sequence.h"
+
+// Prefix sums of the quality values of a sequence, from which the quality of any range is found in constant time.
+// Build one for a read and query it with as many trimming policies and parameters as needed.
+class QualityTrim
+{
+public:
+	static const size_t NOT_FOUND = NucleotideSequence::NOT_FOUND;
+
+	explicit QualityTrim(const NucleotideSequence& sequence);
+
+	size_t Length() const {
+		return quality_sum_.size() - 1;
+	}
+
+	// Sum of the quality values of bases [start, end).
+	size_t QualitySum(size_t start, size_t end) const {
+		return quality_sum_[end] - quality_sum_[start];
+	}
+
+	// Number of bases in [start, end) with no quality value, other than N.
+	size_t MissingCount(size_t start, size_t end) const {
+		return missing_sum_[end] - missing_sum_[start];
+	}
+
+	// The start of the good quality region: the first base at or after the first window of the given size whose
+	// average quality reaches quality, which itself has a quality of at least quality or no quality value. Scanning
+	// stops early if more than half the bases of a window have no quality value. Returns NOT_FOUND if the sequence
+	// is empty or has no quality values.
+	size_t WindowStart(unsigned int window, int quality) const;
+
+	// The end of the good quality region, as for WindowStart() but scanning backwards from the end of the sequence
+	// as far as start_pos.
+	size_t WindowEnd(size_t start_pos, unsigned int window, int quality) const;
+
+	// Mott's modified Richardson algorithm, as used by phred: each base scores limit minus its probability of error,
+	// and the region is the segment [start, end) with the highest total. Returns false if no segment scores above 0.
+	bool Mott(double limit, size_t* start, size_t* end) const;
+
+	// The segment [start, end) with the highest total of quality values less quality. Returns false if no segment
+	// scores above 0.
+	bool MaxSubarray(int quality, size_t* start, size_t* end) const;
+
+private:
+	bool Missing(size_t i) const {
+		return missing_sum_[i + 1] != missing_sum_[i];
+	}
+
+	size_t Quality(size_t i) const {
+		return quality_sum_[i + 1] - quality_sum_[i];
+	}
+
+	// Element i of each sum covers bases [0, i).
+	std::vector<size_t> quality_sum_;
+	std::vector<size_t> missing_sum_;
+	std::vector<double> error_sum_;
+};
@@ -21,6 +21,7 @@
 
 #include <cinttypes>
 #include <string>
+#include <vector>
 #include "endian.h"
 #include "lookuptables.h"
 
@@ -259,8 +260,13 @@ public:
 
     ScfFile& operator=(ScfFile&&) = delete;
 
+    // The called bases. Returns false if there are none.
     bool Sequence(Iterator<char>& begin, Iterator<char>& end) const;
 
+    // The quality of each called base, which is the probability the file records for that base, or 0 for bases
+    // other than A, C, G and T. Returns false if there are no bases.
+    bool CalledBaseQualities(std::vector<uint8_t>& qualities) const;
+
     template <typename T>
     bool Quality(Iterator<T>& begin, Iterator<T>& end) const;
 
@@ -283,8 +289,18 @@ public:
         return true;
     }
 
+    // The trace sample index of each base. Returns false if there are no bases.
     template <typename T>
-    bool Peaks(Iterator<T>& begin, Iterator<T>& end) const;
+    bool Peaks(Iterator<T>& begin, Iterator<T>& end) const {
+        if (!header_->bases)
+            return false;
+        const char* bases = file_buffer_.get() + header_->bases_offset;
+        // Version 3 stores each field of the bases in a separate array, with the peak indexes first.
+        size_t pitch = header_->version[0] < '3' ? sizeof(ScfBase) : sizeof(uint32_t);
+        begin = Iterator<T>(bases, sizeof(uint32_t), pitch);
+        end = begin + header_->bases;
+        return true;
+    }
 
     template <typename T>
     SearchResult SearchTag(const char* tag, int32_t number, Iterator<T>& begin, Iterator<T>& end) const;
@@ -22,6 +22,7 @@
 #include <string>
 #include "lookuptables.h"
 #include "seqcontainer.h"
+#include "tracechannel.h"
 
 class NucleotideSequence
 {
@@ -33,7 +34,7 @@ public:
 	using base_type = char;
 	using quality_type = uint8_t;
 	using peak_type = int32_t;
-	using trace_type = int32_t;
+	using trace_type = TraceChannel::sample_type;
 
 	struct Description
 	{
@@ -48,7 +49,8 @@ public:
 	struct Traces
 	{
 		SeqContainer<peak_type> peaks;
-		std::unique_ptr<trace_type[]> heights[4];
+		// Channels in the order A, C, G, T.
+		TraceChannel heights[4];
 		size_t trace_length;
 	};
 
@@ -75,15 +77,8 @@ public:
 		for (size_t i = 0; i < TRACE_COUNT; ++i)
 			traces_->trace_length = std::max<size_t>(traces_->trace_length, end_trace[i] - begin_trace[i]);
 
-		for (size_t i = 0; i < TRACE_COUNT; ++i) {
-			std::unique_ptr<trace_type[]>& heights = traces_->heights[i];
-			heights = std::make_unique<trace_type[]>(traces_->trace_length);
-			size_t length = 0;
-			for (TraceIterator y = begin_trace[i]; y != end_trace[i]; ++y)
-				heights[length++] = *y;
-			while(length < traces_->trace_length)
-				heights[length++] = 0;
-		}
+		for (size_t i = 0; i < TRACE_COUNT; ++i)
+			traces_->heights[i].Assign(begin_trace[i], end_trace[i], traces_->trace_length);
 	}
 
 	NucleotideSequence& operator=(const NucleotideSequence& rval) = default;
@@ -132,6 +127,16 @@ public:
 		return traces_.operator bool();
 	}
 
+	// Heights of trace channel 0-3 (A, C, G, T), or nullptr if there are no traces. They are stored in 8 or 16 bits
+	// where possible; index the channel or use TraceChannel::Widen() to read them as trace_type.
+	const TraceChannel* TraceHeights(size_t channel) const {
+		return traces_ ? &traces_->heights[channel] : nullptr;
+	}
+
+	size_t TraceLength() const {
+		return traces_ ? traces_->trace_length : 0;
+	}
+
 	bool HasValidQuality() const;
 
 	quality_type QualityOrDefault(size_t pos) const {
@@ -144,12 +149,18 @@ public:
 
 	float ComputeSpacing() const;
 
+	// Mean distance between count peaks in order of position, or 0 if there are fewer than two.
+	static float ComputeSpacing(const peak_type* peaks, size_t count);
+
 	void Replace(size_t start_pos, size_t old_length, const NucleotideSequence& source);
 
 	void Replace(size_t pos, size_t old_length, base_type c, quality_type quality, peak_type peak);
 
 	void DeleteSubsequence(size_t start_pos, size_t length);
 
+	// Replace every base, quality value and peak, as when calling the bases again from the traces, which are kept.
+	void ReplaceCalls(const base_type* bases, const quality_type* quality, const peak_type* peaks, size_t length);
+
 	void ReverseComplement(peak_type trace_length_max);
 
 	size_t SearchSequenceForward(size_t start_pos, const std::string& query, bool both_strands) const;
@@ -160,14 +171,20 @@ public:
 
 	size_t SearchByAlignmentBack(size_t start_pos, const std::string& query, int min_percent) const;
 
-	size_t FindInTranslation(size_t start_pos, bool backwards, const std::string& query, int genetic_code) const;
+	// Find the query peptide in the translation of any forward frame, or of the reverse frames too if both_strands is
+	// set, and return the position of the first base of the match. Redundant amino acid codes match as in
+	// LookupTables::AminoAcidMatch(). Searches forwards from start_pos, or backwards if backwards is set.
+	size_t FindInTranslation(size_t start_pos, bool backwards, const std::string& query, int genetic_code, bool both_strands = false) const;
 
+	// For repeated searches while navigating an edited sequence, keep a PositionClasses instead.
 	size_t FindNextN(size_t start_pos) const;
 
 	size_t FindNextRedundant(size_t start_pos) const;
 
 	bool IsRedundant(size_t pos) const;
 
+	// Find the ends of the good quality region, as by QualityTrim::WindowStart() and WindowEnd(). To try several
+	// parameters or trimming policies, construct a QualityTrim once instead.
 	size_t ComputeQualityStart(unsigned int window, int quality) const;
 
 	size_t ComputeQualityEnd(size_t start_pos, unsigned int window, int quality) const;
@@ -198,8 +215,6 @@ private:
 		return true;
 	}
 
-	bool MatchTranslation(size_t pos, const base_type* query, int genetic_code) const;
-
 	base_type UppercaseBase(size_t i) const {
 		return LookupTables::Uppercase(sequence_[i]);
 	}
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 class System
 {
@@ -28,4 +29,7 @@ public:
 
     static std::string ProgramDataDir();
     static void AppendName(std::string& path, const char* name);
+
+    // Get the names of the regular files in a directory, in no particular order. Returns false if it can't be read.
+    static bool ListDirectory(const char* path, std::vector<std::string>& names);
 };
\ No newline at end of file
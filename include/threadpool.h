@@ -0,0 +1,78 @@
+// Thread pool for running batches of independent jobs on all cores.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// Create a pool which runs jobs on thread_count threads, including the thread that submits them.
+	explicit ThreadPool(unsigned int thread_count);
+
+	ThreadPool(const ThreadPool&) = delete;
+
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool();
+
+	// The shared pool, sized to the number of hardware threads. Created on first use.
+	static ThreadPool& Instance();
+
+	unsigned int ThreadCount() const {
+		return static_cast<unsigned int>(workers_.size()) + 1;
+	}
+
+	// Call function(i) for every i in [0, count) and wait until all calls have returned.
+	// Indices are handed out one at a time, so jobs of uneven size balance themselves.
+	// Calls made from inside a job run serially on the calling thread.
+	// If any job throws, remaining indices are skipped and the first exception is rethrown here.
+	void ForEach(size_t count, const std::function<void(size_t)>& function);
+
+private:
+	struct Batch
+	{
+		const std::function<void(size_t)>* function;
+		size_t count;
+		std::atomic<size_t> next;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	};
+
+	static void RunBatch(Batch& batch);
+
+	void WorkerLoop();
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::mutex submit_mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	Batch* batch_;
+	size_t generation_;
+	size_t active_;
+	bool stop_;
+};
@@ -0,0 +1,82 @@
+// Chromas trace channel class.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// Used by the sequence class to store the samples of one trace channel in 8 or 16 bits where they fit, as they
+// always do for ab1 and SCF files, and to widen them when read.
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class TraceChannel
+{
+public:
+	using sample_type = int32_t;
+
+	TraceChannel()
+		: length_(0), base_(0)
+	{
+	}
+
+	// Load samples from an iterator range, padded with zeros to length.
+	template<class Iterator>
+	void Assign(Iterator begin, Iterator end, size_t length)
+	{
+		std::vector<sample_type> samples;
+		samples.reserve(length);
+		for (Iterator y = begin; y != end && samples.size() < length; ++y)
+			samples.push_back(*y);
+		samples.resize(length, 0);
+		Assign(samples);
+	}
+
+	void Assign(const std::vector<sample_type>& samples);
+
+	size_t Length() const {
+		return length_;
+	}
+
+	// Bytes of storage per sample: 1, 2 or 4.
+	size_t SampleSize() const {
+		return narrow8_ ? 1 : narrow16_ ? 2 : 4;
+	}
+
+	sample_type operator[](size_t i) const {
+		assert(i < length_);
+		if (narrow8_)
+			return base_ + narrow8_[i];
+		if (narrow16_)
+			return base_ + narrow16_[i];
+		return wide_[i];
+	}
+
+	// Copy samples [start, end) to samples at full width.
+	void Widen(size_t start, size_t end, sample_type* samples) const;
+
+private:
+	size_t length_;
+	// Narrow samples are stored as the offset from base_, the smallest sample.
+	sample_type base_;
+	std::unique_ptr<uint8_t[]> narrow8_;
+	std::unique_ptr<uint16_t[]> narrow16_;
+	std::unique_ptr<sample_type[]> wide_;
+};
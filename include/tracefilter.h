@@ -0,0 +1,88 @@
+// Signal processing of trace channels.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include "sequence.h"
+
+// A pipeline of filters over the four trace channels, such as for cleaning up raw ab1 data (DATA 1-4) before calling
+// bases. Stages run in the order they are added. All stages are applied to one block of samples before moving to the
+// next, so the intermediate signals stay in cache. Samples beyond the ends of the traces repeat the end samples.
+class TraceFilter
+{
+public:
+	using trace_type = NucleotideSequence::trace_type;
+
+	static const size_t TRACE_COUNT = NucleotideSequence::TRACE_COUNT;
+
+	// Subtract the minimum of the window samples centred on each sample. Even windows are widened by one.
+	void AddBaselineSubtraction(size_t window);
+
+	// Savitzky-Golay smoothing with a quadratic over 2 * half_width + 1 samples.
+	void AddSmoothing(size_t half_width);
+
+	// Delay channel c by shifts[c] samples, interpolating linearly, to correct for the different mobility of each dye.
+	void AddMobilityShift(const float shifts[TRACE_COUNT]);
+
+	// Scale every channel so that the highest sample of any channel within the window samples centred on each
+	// sample becomes height.
+	void AddNormalization(size_t window, trace_type height);
+
+	bool Empty() const {
+		return stages_.empty();
+	}
+
+	// Number of samples either side of a sample which affect its filtered value.
+	size_t Reach() const;
+
+	// Filter the channels into output, which can be passed to NucleotideSequence::LoadTraces(). Channels shorter than
+	// the longest are padded with zeros, as by LoadTraces().
+	void Apply(const std::vector<trace_type> input[TRACE_COUNT], std::vector<trace_type> output[TRACE_COUNT]) const;
+
+	// Filter the traces of a read. The output is empty if the read has no traces.
+	void Apply(const NucleotideSequence& read, std::vector<trace_type> output[TRACE_COUNT]) const;
+
+private:
+	static const size_t BLOCK_SIZE = 4096;
+
+	enum class StageType
+	{
+		BASELINE,
+		SMOOTHING,
+		SHIFT,
+		NORMALIZATION
+	};
+
+	struct Stage
+	{
+		StageType type;
+		// Samples either side used by the stage.
+		size_t reach;
+		// Smoothing weights of samples -reach to reach.
+		std::vector<float> coefficients;
+		float shifts[TRACE_COUNT];
+		float height;
+	};
+
+	// Filter samples [start, end) of the buffers from samples [start - reach, end + reach).
+	static void ApplyStage(const Stage& stage, const std::vector<float>* in, std::vector<float>* out, size_t start, size_t end);
+
+	std::vector<Stage> stages_;
+};
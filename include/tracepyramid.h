@@ -0,0 +1,78 @@
+// Min/max pyramid of trace heights for drawing zoomed out traces.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include "sequence.h"
+
+// Level k of the pyramid holds the minimum and maximum height of each block of 2^k samples of each trace channel,
+// so the envelope of a range of samples is drawn from a few blocks per pixel however far the view is zoomed out.
+// Levels are built on the first query. Like TranslationCache, it refers to the sequence and must be told of changes.
+class TracePyramid
+{
+public:
+	using trace_type = NucleotideSequence::trace_type;
+
+	struct Extent
+	{
+		trace_type minimum;
+		trace_type maximum;
+	};
+
+	explicit TracePyramid(const NucleotideSequence& sequence);
+
+	// Number of levels including level 0, the samples themselves, once built.
+	size_t LevelCount() const {
+		return levels_[0].size() + 1;
+	}
+
+	// The extent of the samples of a channel under each of pixels columns spanning samples [start, end). Each column
+	// is measured from the largest blocks no wider than a column, so its edges are rounded down to a block boundary.
+	// Columns narrower than a sample repeat it. Takes O(pixels) time once the levels are built.
+	void Envelope(size_t channel, size_t start, size_t end, size_t pixels, std::vector<Extent>* envelope);
+
+	// Rebuild the blocks over samples [start, end) on the next query, after the trace heights there have changed.
+	void Invalidate(size_t start, size_t end);
+
+	// Discard every level, as after NucleotideSequence::LoadTraces() loads traces of another length.
+	void Refresh();
+
+private:
+	struct Level
+	{
+		std::vector<trace_type> minimum;
+		std::vector<trace_type> maximum;
+	};
+
+	// Build every level, or only the blocks over the invalidated samples if the levels exist.
+	void Build();
+
+	// Compute blocks [first, last) of level k of a channel from level k - 1.
+	void BuildBlocks(size_t channel, size_t k, size_t first, size_t last);
+
+	const NucleotideSequence& sequence_;
+	size_t trace_length_;
+	bool built_;
+	// Samples invalidated since the levels were built. Empty if start >= end.
+	size_t invalid_start_;
+	size_t invalid_end_;
+	// Level k is stored at levels_[channel][k - 1].
+	std::vector<Level> levels_[NucleotideSequence::TRACE_COUNT];
+};
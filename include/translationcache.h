@@ -0,0 +1,62 @@
+// Cached translation of all six reading frames of a sequence.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include "sequence.h"
+
+class TranslationCache
+{
+public:
+	static const size_t FRAME_COUNT = 3;
+
+	TranslationCache(const NucleotideSequence& sequence, size_t genetic_code);
+
+	size_t GeneticCode() const {
+		return genetic_code_;
+	}
+
+	void SetGeneticCode(size_t genetic_code);
+
+	// Amino acids of the codons starting at frame, frame + 3, frame + 6... For the reverse strand each codon is
+	// translated from its reverse complement, but frames are still numbered and stored from the sequence start,
+	// so amino acid i of either strand covers bases [frame + i * 3, frame + i * 3 + 3).
+	const std::string& Frame(size_t frame, bool reverse) const {
+		return frames_[reverse * FRAME_COUNT + frame];
+	}
+
+	// Update the frames after bases [pos, pos + old_length) of the sequence have been replaced by new_length bases,
+	// as by NucleotideSequence::Replace() or DeleteSubsequence(). Only codons overlapping the edit are translated;
+	// the rest are moved, to a different frame if the length changed by other than a multiple of three.
+	void Update(size_t pos, size_t old_length, size_t new_length);
+
+	// Translate all frames from scratch.
+	void Refresh();
+
+private:
+	// Number of complete codons in a frame of a sequence of the given length.
+	static size_t CodonCount(size_t length, size_t frame) {
+		return length > frame ? (length - frame) / 3 : 0;
+	}
+
+	const NucleotideSequence& sequence_;
+	size_t genetic_code_;
+	std::string frames_[FRAME_COUNT * 2];
+};
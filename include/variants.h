@@ -0,0 +1,97 @@
+// Variant calling from trace reads aligned to a reference.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include "sequence.h"
+
+class VariantCaller
+{
+public:
+	enum class Type
+	{
+		SNV,         // The read base differs from the reference.
+		HETEROZYGOTE // A secondary peak is high enough to indicate two alleles.
+	};
+
+	struct Call
+	{
+		Type type;
+		// Positions of the call in the reference and the read.
+		size_t position;
+		size_t read_position;
+		char reference_base;
+		char read_base;
+		// The read base for an SNV, or the IUPAC code of the two highest trace channels for a heterozygote.
+		char call;
+		// Height of the second highest trace channel as a percentage of the highest, at the read base's peak.
+		int secondary_percent;
+		int quality;
+	};
+
+	// Align the read locally to the reference and call variants in the aligned columns which have a read base
+	// quality of at least min_quality. Positions where the secondary peak reaches min_secondary_percent of the
+	// primary are called as heterozygotes, and need traces. Reverse reads should be reverse complemented first.
+	// Returns false if the read could not be aligned.
+	static bool CallVariants(const NucleotideSequence& reference, const NucleotideSequence& read, int min_secondary_percent, int min_quality, std::vector<Call>* calls);
+
+	// Call variants in every read, as above, storing the calls for read i in calls[i].
+	// Reads are processed in parallel on the shared thread pool.
+	static void CallVariants(const NucleotideSequence& reference, const NucleotideSequence* const* reads, size_t read_count, int min_secondary_percent, int min_quality, std::vector<Call>* calls);
+
+	struct SecondaryPeak
+	{
+		// Height of each trace channel (A, C, G, T) at the base's peak.
+		NucleotideSequence::trace_type heights[NucleotideSequence::TRACE_COUNT];
+		// Channel of the read base, or the highest channel if the base is not A, C, G or T.
+		size_t called_channel;
+		// The highest of the other channels.
+		size_t secondary_channel;
+		// Height of the secondary channel as a percentage of the called channel.
+		int secondary_percent;
+		// The IUPAC code of both channels where secondary_percent reaches recall_percent, otherwise the read base.
+		char call;
+	};
+
+	// Measure the secondary peak at every base of a read, for heterozygote screening without a reference. All four
+	// channels are gathered at every peak in one pass over each channel. A recall_percent of 0 disables recalling.
+	// Bases beyond the last peak of a read with fewer peaks than bases have no entry. Returns false with peaks empty if
+	// the read has no traces.
+	static bool SecondaryPeaks(const NucleotideSequence& read, int recall_percent, std::vector<SecondaryPeak>* peaks);
+
+	// Measure every read, as above, storing the table for read i in peaks[i], in parallel on the shared thread pool.
+	static void SecondaryPeaks(const NucleotideSequence* const* reads, size_t read_count, int recall_percent, std::vector<SecondaryPeak>* peaks);
+
+private:
+	// Trace samples either side of a peak which are searched for the height of each channel.
+	static const NucleotideSequence::peak_type PEAK_HALF_WIDTH = 1;
+
+	// Get the secondary peak percentage for each of count read positions.
+	static void ComputeSecondaryPercents(const NucleotideSequence& read, const size_t* read_positions, size_t count, int* percents);
+
+	// Height of a trace channel at the peak of a read base, allowing for slight misplacement of the peak. 0 for a base
+	// beyond the last peak.
+	static NucleotideSequence::trace_type PeakHeight(const NucleotideSequence& read, size_t channel, size_t read_position);
+
+	// Highest of sample_count samples within PEAK_HALF_WIDTH of peak, which is first moved into the samples.
+	static NucleotideSequence::trace_type WindowHeight(const NucleotideSequence::trace_type* samples, size_t sample_count, NucleotideSequence::peak_type peak);
+
+	static char HeterozygoteCall(const NucleotideSequence& read, size_t read_position);
+};
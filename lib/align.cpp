@@ -17,8 +17,12 @@
 // You should have received a copy of the GNU General Public License
 // along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <bitset>
+#include <numeric>
+#include <vector>
 #include "align.h"
+#include "threadpool.h"
 
 Alignment::ScoringMatrix Alignment::matrix_;
 
@@ -52,10 +56,14 @@ void Alignment::ScoringMatrix::Initialize(int match, int mismatch)
 
 static const size_t VECTOR_MIN_MATCH = 11;
 
-bool Alignment::Search(const NucleotideSequence& sequence, size_t start, size_t end, size_t max_result, const char* query, int min_percent, Alignment::Result* result_)
+bool Alignment::Search(const NucleotideSequence& sequence, size_t start, size_t end, size_t max_result, const char* query, int min_percent, Alignment::Result* result)
 {
 	InitializeMatrix();
+	return SearchUninitialized(sequence, start, end, max_result, query, min_percent, result);
+}
 
+bool Alignment::SearchUninitialized(const NucleotideSequence& sequence, size_t start, size_t end, size_t max_result, const char* query, int min_percent, Alignment::Result* result_)
+{
 	start -= (start != 0);
 
 	size_t across = strlen(query);
@@ -110,7 +118,125 @@ bool Alignment::Search(const NucleotideSequence& sequence, size_t start, size_t
 	return result.score >= min_score;
 }
 
-static const int N_QUALITY = 5;
+void Alignment::BatchSearch(const NucleotideSequence* const* sequences, size_t sequence_count, const char* const* queries, size_t query_count, int min_percent, Alignment::Result* results)
+{
+	InitializeMatrix();
+
+	// Sort short sequences by length so that each lane group has little idle time at its start.
+	std::vector<size_t> order(sequence_count);
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [sequences](size_t a, size_t b) {
+		return sequences[a]->Length() < sequences[b]->Length();
+	});
+	size_t short_count = 0;
+	while (short_count < sequence_count && sequences[order[short_count]]->Length() <= LANE_MAX_LENGTH)
+		++short_count;
+	size_t group_count = (short_count + LANE_COUNT - 1) / LANE_COUNT;
+	size_t jobs_per_query = group_count + sequence_count - short_count;
+
+	ThreadPool::Instance().ForEach(jobs_per_query * query_count, [=, &order](size_t job) {
+		size_t q = job / jobs_per_query;
+		size_t index = job % jobs_per_query;
+		if (index < group_count) {
+			const NucleotideSequence* group[LANE_COUNT] = {};
+			Result lane_results[LANE_COUNT];
+			size_t first = index * LANE_COUNT;
+			size_t count = std::min(size_t(LANE_COUNT), short_count - first);
+			for (size_t lane = 0; lane < count; ++lane)
+				group[lane] = sequences[order[first + lane]];
+			LaneSearch(group, count, queries[q], min_percent, lane_results, 1);
+			for (size_t lane = 0; lane < count; ++lane)
+				results[order[first + lane] * query_count + q] = lane_results[lane];
+		}
+		else {
+			size_t i = order[short_count + index - group_count];
+			Result& result = results[i * query_count + q];
+			if (!SearchUninitialized(*sequences[i], 0, sequences[i]->Length(), sequences[i]->Length(), queries[q], min_percent, &result))
+				result = { -1, -1 };
+		}
+	});
+}
+
+// Equivalent to SearchUninitialized() over the whole of each sequence, but with up to LANE_COUNT sequences aligned
+// together. The lane loops have no dependencies between lanes so they can be compiled to vector instructions.
+void Alignment::LaneSearch(const NucleotideSequence* const* sequences, size_t count, const char* query, int min_percent, Alignment::Result* results, size_t result_stride)
+{
+	assert(count <= LANE_COUNT);
+
+	size_t across = strlen(query);
+	auto query_index = std::make_unique<uint8_t[]>(across);
+	for (size_t x = 0; x < across; ++x)
+		query_index[x] = LookupTables::IupacIndex(query[x]);
+
+	int length[LANE_COUNT];
+	ptrdiff_t down = 0;
+	for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+		length[lane] = lane < count ? static_cast<int>(sequences[lane]->Length()) : 0;
+		down = std::max<ptrdiff_t>(down, length[lane]);
+	}
+
+	auto scores = std::make_unique<int[]>(across * LANE_COUNT);
+	for (size_t x = 0; x < across; ++x)
+		for (size_t lane = 0; lane < LANE_COUNT; ++lane)
+			scores[x * LANE_COUNT + lane] = static_cast<int>((across - x) * ALIGN_GAP_OPEN);
+
+	int min_score = ComputeSearchMinScore(across, min_percent);
+
+	int prev_score[LANE_COUNT], prev_score_2[LANE_COUNT], result_start[LANE_COUNT], result_score[LANE_COUNT];
+	std::fill_n(prev_score, LANE_COUNT, -1);
+	std::fill_n(prev_score_2, LANE_COUNT, -1);
+	std::fill_n(result_start, LANE_COUNT, -1);
+	std::fill_n(result_score, LANE_COUNT, -1);
+
+	for (ptrdiff_t y = down - 1; y >= 0; y--) {
+		const int* row_matrix[LANE_COUNT];
+		int active[LANE_COUNT];
+		for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+			active[lane] = y < length[lane];
+			row_matrix[lane] = active[lane] ? GetSearchMatrix((*sequences[lane])[y]) : matrix_[LookupTables::IUPAC_UNDEFINED_INDEX];
+		}
+
+		int prev_x[LANE_COUNT] = {};
+		int prev_d[LANE_COUNT] = {};
+		for (ptrdiff_t x = across - 1; x >= 0; x--) {
+			int* column = scores.get() + x * LANE_COUNT;
+			uint8_t q = query_index[x];
+			for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+				int match = prev_d[lane] + row_matrix[lane][q];
+				int d = column[lane];
+				int score = std::max(match, std::max(prev_x[lane], d) + ALIGN_GAP_OPEN);
+				// Lanes which have not reached their sequence yet keep their initial scores.
+				score = active[lane] ? score : d;
+				prev_d[lane] = d;
+				column[lane] = score;
+				prev_x[lane] = score;
+			}
+		}
+
+		for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+			if (!active[lane])
+				continue;
+			if (prev_x[lane] <= prev_score[lane] && prev_score[lane] >= prev_score_2[lane] && prev_score[lane] >= min_score) {
+				result_start[lane] = static_cast<int>(y + 1);
+				result_score[lane] = prev_score[lane];
+			}
+			prev_score_2[lane] = prev_score[lane];
+			prev_score[lane] = prev_x[lane];
+		}
+	}
+
+	for (size_t lane = 0; lane < count; ++lane) {
+		if (result_start[lane] < 0 && prev_score[lane] >= min_score) {
+			result_start[lane] = 0;
+			result_score[lane] = prev_score[lane];
+		}
+		Result& result = results[lane * result_stride];
+		if (result_score[lane] >= min_score)
+			result = { result_score[lane], result_start[lane] };
+		else
+			result = { -1, -1 };
+	}
+}
 
 bool Alignment::VectorSearch5(const NucleotideSequence& sequence, const char* query, int min_percent, size_t min_match, Alignment::Result* result_)
 {
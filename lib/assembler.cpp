@@ -0,0 +1,342 @@
+// Assembly of overlapping reads into contigs.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <memory>
+#include "assembler.h"
+#include "align.h"
+#include "consensus.h"
+#include "threadpool.h"
+
+void Assembler::FindOverlaps(const NucleotideSequence* const* reads, size_t read_count, size_t min_overlap, int min_percent, std::vector<Overlap>* overlaps)
+{
+	overlaps->clear();
+	std::vector<std::string> bases(read_count);
+	std::vector<Seed> seeds;
+	for (size_t i = 0; i < read_count; ++i) {
+		bases[i].assign(reads[i]->cbegin(), reads[i]->cend());
+		AddSeeds(bases[i], uint32_t(i), &seeds);
+	}
+	auto by_kmer = [](const Seed& x, const Seed& y) { return x.kmer < y.kmer; };
+	std::stable_sort(seeds.begin(), seeds.end(), by_kmer);
+
+	// Drop k-mers which occur too often to be informative.
+	size_t kept = 0;
+	for (size_t i = 0; i < seeds.size();) {
+		size_t j = i + 1;
+		while (j < seeds.size() && seeds[j].kmer == seeds[i].kmer)
+			++j;
+		if (j - i <= MAX_KMER_OCCURRENCES) {
+			std::copy(seeds.begin() + i, seeds.begin() + j, seeds.begin() + kept);
+			kept += j - i;
+		}
+		i = j;
+	}
+	seeds.resize(kept);
+
+	// Each read is compared with the reads before it, on both strands, so that each pair is tried once.
+	std::vector<std::vector<Overlap>> found(read_count);
+	ThreadPool::Instance().ForEach(read_count, [&](size_t i) {
+		for (int strand = 0; strand < 2; ++strand) {
+			std::string query = strand ? LookupTables::ReverseComplement(bases[i]) : bases[i];
+			std::vector<Seed> query_seeds;
+			AddSeeds(query, uint32_t(i), &query_seeds);
+
+			// The diagonal of a shared k-mer is the offset of the query in the other read.
+			std::vector<std::pair<size_t, ptrdiff_t>> hits;
+			for (auto& seed : query_seeds) {
+				auto range = std::equal_range(seeds.cbegin(), seeds.cend(), seed, by_kmer);
+				for (auto hit = range.first; hit != range.second; ++hit) {
+					if (hit->read < i)
+						hits.emplace_back(hit->read, ptrdiff_t(hit->position) - ptrdiff_t(seed.position));
+				}
+			}
+			std::sort(hits.begin(), hits.end());
+
+			// Align each read at the band of diagonals with the most hits.
+			for (size_t first = 0; first < hits.size();) {
+				size_t read = hits[first].first;
+				size_t last = first;
+				size_t best_count = 0;
+				ptrdiff_t best_offset = 0;
+				for (size_t j = first; j < hits.size() && hits[j].first == read; ++j) {
+					while (hits[j].second - hits[first].second > ptrdiff_t(DIAGONAL_BAND))
+						++first;
+					if (j - first + 1 > best_count) {
+						best_count = j - first + 1;
+						best_offset = hits[first + (j - first) / 2].second;
+					}
+					last = j + 1;
+				}
+				Overlap overlap;
+				if (best_count >= MIN_SEED_HITS && VerifyOverlap(*reads[read], query, best_offset, min_overlap, min_percent, &overlap)) {
+					overlap.first = read;
+					overlap.second = i;
+					overlap.reverse = strand != 0;
+					found[i].push_back(overlap);
+				}
+				first = last;
+			}
+		}
+	});
+	for (auto& read_overlaps : found)
+		overlaps->insert(overlaps->end(), read_overlaps.cbegin(), read_overlaps.cend());
+}
+
+void Assembler::Assemble(const NucleotideSequence* const* reads, size_t read_count, size_t min_overlap, int min_percent, std::vector<Contig>* contigs)
+{
+	contigs->clear();
+	std::vector<Overlap> overlaps;
+	FindOverlaps(reads, read_count, min_overlap, min_percent, &overlaps);
+	std::stable_sort(overlaps.begin(), overlaps.end(), [](const Overlap& x, const Overlap& y) { return x.score > y.score; });
+
+	// Each read starts in a group of its own. Taking an overlap moves the group of its second read into the frame of
+	// the first, mirrored if the orientations disagree.
+	std::vector<Layout> layout(read_count);
+	std::vector<size_t> group(read_count);
+	std::vector<std::vector<size_t>> members(read_count);
+	for (size_t i = 0; i < read_count; ++i) {
+		layout[i] = Layout{ i, false, 0 };
+		group[i] = i;
+		members[i].push_back(i);
+	}
+	for (auto& overlap : overlaps) {
+		size_t target_group = group[overlap.first];
+		size_t moved_group = group[overlap.second];
+		if (target_group == moved_group)
+			continue;
+		const Layout& first = layout[overlap.first];
+		const Layout& second = layout[overlap.second];
+		ptrdiff_t first_length = ptrdiff_t(reads[overlap.first]->Length());
+		ptrdiff_t second_length = ptrdiff_t(reads[overlap.second]->Length());
+		bool reverse = overlap.reverse != first.reverse;
+		ptrdiff_t position = first.reverse ? first.position + first_length - (overlap.offset + second_length) : first.position + overlap.offset;
+		bool mirror = second.reverse != reverse;
+		ptrdiff_t shift = mirror ? position + second.position + second_length : position - second.position;
+		for (size_t read : members[moved_group]) {
+			Layout& moved = layout[read];
+			if (mirror) {
+				moved.position = -(moved.position + ptrdiff_t(reads[read]->Length()));
+				moved.reverse = !moved.reverse;
+			}
+			moved.position += shift;
+			group[read] = target_group;
+			members[target_group].push_back(read);
+		}
+		members[moved_group].clear();
+	}
+
+	// Contigs are ordered by their lowest numbered read, and oriented to have it forward.
+	std::vector<std::vector<Layout>> contig_layouts;
+	for (size_t i = 0; i < read_count; ++i) {
+		if (members[group[i]].empty())
+			continue;
+		bool mirror = layout[i].reverse;
+		std::vector<Layout> contig_layout;
+		for (size_t read : members[group[i]]) {
+			Layout placed = layout[read];
+			if (mirror) {
+				placed.position = -(placed.position + ptrdiff_t(reads[read]->Length()));
+				placed.reverse = !placed.reverse;
+			}
+			contig_layout.push_back(placed);
+		}
+		members[group[i]].clear();
+		contig_layouts.push_back(contig_layout);
+	}
+
+	contigs->resize(contig_layouts.size());
+	std::vector<std::vector<size_t>> unplaced(contig_layouts.size());
+	ThreadPool::Instance().ForEach(contig_layouts.size(), [&](size_t i) {
+		BuildContig(reads, contig_layouts[i], &(*contigs)[i], &unplaced[i]);
+	});
+	for (auto& contig_unplaced : unplaced) {
+		for (size_t read : contig_unplaced) {
+			contigs->emplace_back();
+			BuildContig(reads, { Layout{ read, false, 0 } }, &contigs->back(), nullptr);
+		}
+	}
+}
+
+void Assembler::AddSeeds(const std::string& bases, uint32_t read, std::vector<Seed>* seeds)
+{
+	const uint32_t mask = (uint32_t(1) << (KMER_LENGTH * 2)) - 1;
+	uint32_t kmer = 0;
+	size_t valid = 0;
+	for (size_t i = 0; i < bases.length(); ++i) {
+		int index = LookupTables::BaseCode(bases[i]);
+		if (index < 0) {
+			valid = 0;
+			continue;
+		}
+		kmer = ((kmer << 2) | uint32_t(index)) & mask;
+		if (++valid >= KMER_LENGTH)
+			seeds->push_back(Seed{ kmer, read, uint32_t(i + 1 - KMER_LENGTH) });
+	}
+}
+
+void Assembler::Orient(const NucleotideSequence& read, bool reverse, NucleotideSequence* oriented)
+{
+	*oriented = NucleotideSequence(read.cbegin(), read.cend(), read.QualityBegin(), read.QualityEnd());
+	if (reverse && !oriented->Empty())
+		oriented->ReverseComplement(0);
+}
+
+bool Assembler::VerifyOverlap(const NucleotideSequence& first, const std::string& second, ptrdiff_t offset, size_t min_overlap, int min_percent, Overlap* overlap)
+{
+	ptrdiff_t first_length = ptrdiff_t(first.Length());
+	ptrdiff_t second_length = ptrdiff_t(second.length());
+	ptrdiff_t band = ptrdiff_t(DIAGONAL_BAND);
+	// The overlap on the diagonal, widened by the band so that indels near its ends still align.
+	ptrdiff_t start = std::max<ptrdiff_t>(std::max<ptrdiff_t>(offset, 0) - band, 0);
+	ptrdiff_t end = std::min(std::min(first_length, offset + second_length) + band, first_length);
+	ptrdiff_t query_start = std::min(std::max<ptrdiff_t>(start - offset, 0), second_length);
+	ptrdiff_t query_end = std::min(std::max<ptrdiff_t>(end - offset, 0), second_length);
+	if (end - start < ptrdiff_t(min_overlap) || query_end - query_start < ptrdiff_t(min_overlap))
+		return false;
+
+	std::string query = second.substr(size_t(query_start), size_t(query_end - query_start));
+	Alignment::Traceback traceback;
+	if (!Alignment::AlignBanded(first, size_t(start), size_t(end), query.c_str(), Alignment::Mode::LOCAL, DIAGONAL_BAND, false, &traceback))
+		return false;
+	size_t columns = traceback.aligned_sequence.length();
+	size_t matches = 0;
+	for (size_t k = 0; k < columns; ++k)
+		matches += LookupTables::Uppercase(traceback.aligned_sequence[k]) == LookupTables::Uppercase(traceback.aligned_query[k]);
+	if (columns < min_overlap || matches * 100 < size_t(min_percent) * columns)
+		return false;
+
+	// Only poor quality ends may be left unaligned, so the alignment must reach an end of each read on both sides.
+	ptrdiff_t overhang = ptrdiff_t(MAX_OVERHANG);
+	ptrdiff_t second_start = query_start + ptrdiff_t(traceback.query_start);
+	ptrdiff_t second_end = query_start + ptrdiff_t(traceback.query_end);
+	bool left = ptrdiff_t(traceback.start) <= overhang || second_start <= overhang;
+	bool right = ptrdiff_t(traceback.end) >= first_length - overhang || second_end >= second_length - overhang;
+	if (!left || !right)
+		return false;
+
+	overlap->offset = ptrdiff_t(traceback.start) - second_start;
+	overlap->score = traceback.score;
+	overlap->length = columns;
+	overlap->percent = int(matches * 100 / columns);
+	return true;
+}
+
+void Assembler::BuildContig(const NucleotideSequence* const* reads, std::vector<Layout> layout, Contig* contig, std::vector<size_t>* unplaced)
+{
+	std::stable_sort(layout.begin(), layout.end(), [](const Layout& x, const Layout& y) { return x.position < y.position; });
+	ptrdiff_t origin = layout.front().position;
+	// The aligned part of each read, oriented, which the consensus refers to.
+	std::vector<std::unique_ptr<NucleotideSequence>> aligned_reads;
+	std::vector<Consensus::AlignedRead> alignment;
+	Consensus consensus(alignment);
+	std::vector<Placement> placements;
+	// Columns inserted so far, which move the later reads along from their laid out positions.
+	size_t inserted = 0;
+	NucleotideSequence oriented;
+	for (auto& placed : layout) {
+		Orient(*reads[placed.read], placed.reverse, &oriented);
+		size_t length = oriented.Length();
+		size_t column_count = consensus.ColumnCount();
+		if (!column_count) {
+			aligned_reads.push_back(std::make_unique<NucleotideSequence>(oriented.cbegin(), oriented.cend(), oriented.QualityBegin(), oriented.QualityEnd()));
+			alignment.push_back(Consensus::AlignedRead{ aligned_reads.back().get(), 0, std::string(oriented.cbegin(), oriented.cend()) });
+			consensus.AddRead(alignment.back());
+			placements.push_back(Placement{ placed.read, placed.reverse, 0, length });
+			continue;
+		}
+
+		// Align the read to the consensus around where the layout puts it.
+		size_t expected = std::min(size_t(placed.position - origin) + inserted, column_count);
+		size_t window_start = expected > LAYOUT_MARGIN ? expected - LAYOUT_MARGIN : 0;
+		size_t window_end = std::min(expected + length + LAYOUT_MARGIN, column_count);
+		std::string calls(column_count, 'N');
+		for (size_t i = 0; i < column_count; ++i)
+			calls[i] = consensus.Call(i);
+		NucleotideSequence target(calls.c_str());
+		std::string query(oriented.cbegin(), oriented.cend());
+		Alignment::Traceback traceback;
+		if (window_start >= window_end || !Alignment::AlignBanded(target, window_start, window_end, query.c_str(), Alignment::Mode::LOCAL, LAYOUT_MARGIN * 2, false, &traceback)) {
+			if (unplaced)
+				unplaced->push_back(placed.read);
+			continue;
+		}
+
+		std::string aligned;
+		size_t column = traceback.start;
+		size_t q = traceback.query_start;
+		for (size_t k = 0; k < traceback.aligned_sequence.length(); ++k) {
+			if (traceback.aligned_sequence[k] == '-') {
+				// A base missing from the consensus gets a new column, with gaps for the reads already across it.
+				for (size_t r = 0; r < alignment.size(); ++r) {
+					Consensus::AlignedRead& other = alignment[r];
+					if (other.start >= column)
+						++other.start;
+					else if (other.start + other.aligned.length() > column)
+						other.aligned.insert(column - other.start, 1, '-');
+					else
+						continue;
+					consensus.UpdateRead(r, other.start, other.aligned);
+				}
+				for (auto& placement : placements) {
+					placement.start += placement.start >= column;
+					placement.end += placement.end > column;
+				}
+				++inserted;
+				++column_count;
+				aligned.push_back(oriented[q++]);
+			}
+			else {
+				aligned.push_back(traceback.aligned_query[k] == '-' ? '-' : oriented[q++]);
+			}
+			++column;
+		}
+		// The rest of a read which runs past the end of the contig extends it.
+		if (column == column_count) {
+			aligned.append(oriented.cbegin() + q, oriented.cend());
+			column += length - q;
+			q = length;
+		}
+		aligned_reads.push_back(std::make_unique<NucleotideSequence>(oriented.cbegin() + traceback.query_start, oriented.cbegin() + q,
+			oriented.QualityBegin() + traceback.query_start, oriented.QualityBegin() + q));
+		alignment.push_back(Consensus::AlignedRead{ aligned_reads.back().get(), traceback.start, aligned });
+		consensus.AddRead(alignment.back());
+		placements.push_back(Placement{ placed.read, placed.reverse, traceback.start, column });
+	}
+
+	// Columns where the gap wins are dropped from the consensus.
+	contig->consensus.clear();
+	contig->quality.clear();
+	std::vector<size_t> positions(consensus.ColumnCount() + 1);
+	for (size_t i = 0; i < consensus.ColumnCount(); ++i) {
+		positions[i] = contig->consensus.length();
+		char call = consensus.Call(i);
+		if (call == '-')
+			continue;
+		contig->consensus.push_back(call);
+		contig->quality.push_back(consensus.Quality(i));
+	}
+	positions[consensus.ColumnCount()] = contig->consensus.length();
+	for (auto& placement : placements) {
+		placement.start = positions[placement.start];
+		placement.end = positions[placement.end];
+	}
+	std::stable_sort(placements.begin(), placements.end(), [](const Placement& x, const Placement& y) { return x.start < y.start; });
+	contig->reads = placements;
+}
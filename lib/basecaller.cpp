@@ -0,0 +1,199 @@
+// Calling bases from trace data.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "basecaller.h"
+#include "threadpool.h"
+
+using trace_type = NucleotideSequence::trace_type;
+using peak_type = NucleotideSequence::peak_type;
+
+static const char TRACE_BASES[] = "ACGT";
+
+// Spacing error assigned to calls made in gaps between peaks.
+static const float GAP_SPACING_ERROR = 0.5f;
+
+static const int SPACING_PASSES = 3;
+
+void BaseCaller::FindPeaks(const trace_type* samples, size_t length, size_t channel, trace_type min_height, std::vector<Peak>* peaks)
+{
+	if (length < 3)
+		return;
+	// Samples that rise from the one before, don't fall to the next and reach min_height are marked in a first pass,
+	// and only those are followed along plateaus.
+	std::vector<uint8_t> candidates(length, 0);
+	for (size_t i = 1; i + 1 < length; ++i)
+		candidates[i] = (samples[i] > samples[i - 1]) & (samples[i] >= samples[i + 1]) & (samples[i] >= min_height);
+
+	for (size_t i = 1; i + 1 < length; ++i) {
+		if (!candidates[i])
+			continue;
+		// A plateau is only a peak if the trace falls after it.
+		size_t j = i + 1;
+		while (j < length && samples[j] == samples[i])
+			++j;
+		if (j == length || samples[j] < samples[i])
+			peaks->push_back(Peak{ peak_type(i), channel, samples[i] });
+	}
+}
+
+float BaseCaller::EstimateSpacing(const std::vector<Peak>& peaks)
+{
+	// Small peaks between bases shorten the gaps, so peaks closer than half the estimate are merged and it is measured
+	// again.
+	float spacing = 0.0f;
+	float min_distance = 2.0f;
+	std::vector<Peak> merged;
+	std::vector<peak_type> gaps;
+	for (int pass = 0; pass < SPACING_PASSES; ++pass) {
+		MergePeaks(peaks, min_distance, &merged);
+		if (merged.size() < 2)
+			return 0.0f;
+		gaps.clear();
+		for (size_t i = 1; i < merged.size(); ++i)
+			gaps.push_back(merged[i].position - merged[i - 1].position);
+		auto median = gaps.begin() + gaps.size() / 2;
+		std::nth_element(gaps.begin(), median, gaps.end());
+		if (float(*median) == spacing)
+			break;
+		spacing = float(*median);
+		min_distance = std::max(spacing / 2, 2.0f);
+	}
+	return spacing;
+}
+
+bool BaseCaller::Call(const NucleotideSequence& read, int mixed_percent, Calls* calls)
+{
+	size_t trace_length = read.TraceLength();
+	if (!read.HasTraces() || trace_length < 3)
+		return false;
+
+	std::vector<trace_type> heights[NucleotideSequence::TRACE_COUNT];
+	trace_type highest = 0;
+	for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+		heights[c].resize(trace_length);
+		read.TraceHeights(c)->Widen(0, trace_length, heights[c].data());
+		highest = std::max(highest, *std::max_element(heights[c].cbegin(), heights[c].cend()));
+	}
+	trace_type min_height = std::max<trace_type>(trace_type(int64_t(highest) * MIN_PEAK_PERCENT / 100), 1);
+
+	std::vector<Peak> peaks;
+	for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c)
+		FindPeaks(heights[c].data(), trace_length, c, min_height, &peaks);
+	std::stable_sort(peaks.begin(), peaks.end(), [](const Peak& x, const Peak& y) { return x.position < y.position; });
+	float spacing = EstimateSpacing(peaks);
+	if (spacing <= 0.0f)
+		return false;
+	std::vector<Peak> called;
+	MergePeaks(peaks, spacing / 2, &called);
+
+	// Fill gaps left by missing peaks with evenly spaced positions.
+	std::vector<peak_type> positions;
+	std::vector<float> spacing_errors;
+	for (size_t i = 0; i < called.size(); ++i) {
+		if (i > 0) {
+			peak_type gap = called[i].position - called[i - 1].position;
+			if (gap > spacing * 1.5f) {
+				int missing = int(std::lround(gap / spacing)) - 1;
+				for (int k = 1; k <= missing; ++k) {
+					positions.push_back(called[i - 1].position + peak_type(int64_t(gap) * k / (missing + 1)));
+					spacing_errors.push_back(GAP_SPACING_ERROR);
+				}
+			}
+		}
+		// Measured from the gaps to the neighbouring peaks, relative to the spacing.
+		float error = 0.0f;
+		if (i > 0)
+			error += std::fabs(called[i].position - called[i - 1].position - spacing);
+		if (i + 1 < called.size())
+			error += std::fabs(called[i + 1].position - called[i].position - spacing);
+		positions.push_back(called[i].position);
+		spacing_errors.push_back(std::min(error / (spacing * 2), GAP_SPACING_ERROR));
+	}
+
+	calls->bases.resize(positions.size());
+	calls->quality.resize(positions.size());
+	calls->peaks = positions;
+	for (size_t i = 0; i < positions.size(); ++i)
+		CallPosition(heights, trace_length, positions[i], mixed_percent, spacing_errors[i], &calls->bases[i], &calls->quality[i]);
+	calls->spacing = NucleotideSequence::ComputeSpacing(positions.data(), positions.size());
+	return true;
+}
+
+bool BaseCaller::Recall(NucleotideSequence* read, int mixed_percent)
+{
+	Calls calls;
+	if (!Call(*read, mixed_percent, &calls))
+		return false;
+	read->ReplaceCalls(calls.bases.data(), calls.quality.data(), calls.peaks.data(), calls.bases.length());
+	return true;
+}
+
+void BaseCaller::Recall(NucleotideSequence* const* reads, size_t read_count, int mixed_percent, bool* results)
+{
+	ThreadPool::Instance().ForEach(read_count, [&](size_t i) {
+		results[i] = Recall(reads[i], mixed_percent);
+	});
+}
+
+void BaseCaller::MergePeaks(const std::vector<Peak>& peaks, float min_distance, std::vector<Peak>* merged)
+{
+	merged->clear();
+	for (const Peak& peak : peaks) {
+		if (!merged->empty() && peak.position - merged->back().position < min_distance) {
+			if (peak.height > merged->back().height)
+				merged->back() = peak;
+		}
+		else {
+			merged->push_back(peak);
+		}
+	}
+}
+
+void BaseCaller::CallPosition(const std::vector<trace_type>* heights, size_t trace_length, peak_type position, int mixed_percent, float spacing_error, char* base, NucleotideSequence::quality_type* quality)
+{
+	peak_type first = std::max<peak_type>(position - PEAK_HALF_WIDTH, 0);
+	peak_type last = std::min<peak_type>(position + PEAK_HALF_WIDTH, peak_type(trace_length - 1));
+	trace_type height[NucleotideSequence::TRACE_COUNT];
+	size_t order[NucleotideSequence::TRACE_COUNT];
+	for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+		height[c] = *std::max_element(heights[c].cbegin() + first, heights[c].cbegin() + last + 1);
+		order[c] = c;
+	}
+	std::sort(order, order + NucleotideSequence::TRACE_COUNT, [&](size_t x, size_t y) { return height[x] > height[y]; });
+
+	trace_type primary = height[order[0]];
+	trace_type secondary = height[order[1]];
+	if (primary <= 0) {
+		*base = 'N';
+		*quality = MIN_QUALITY;
+		return;
+	}
+	bool mixed = mixed_percent > 0 && secondary > 0 && int64_t(secondary) * 100 >= int64_t(primary) * mixed_percent;
+	*base = mixed ? LookupTables::TwoBaseCode(int(order[0]), int(order[1])) : TRACE_BASES[order[0]];
+
+	// The chance of an error rises with the signal left unexplained by the call, and with a misplaced peak.
+	trace_type called = mixed ? secondary : primary;
+	trace_type unused = std::max<trace_type>(height[order[mixed ? 2 : 1]], 0);
+	double error = 0.5 * unused / called + 0.5 * spacing_error;
+	error = std::min(std::max(error, std::pow(10.0, -MAX_QUALITY / 10.0)), 0.75);
+	long q = std::lround(-10.0 * std::log10(error));
+	*quality = NucleotideSequence::quality_type(std::min<long>(std::max<long>(q, MIN_QUALITY), MAX_QUALITY));
+}
@@ -0,0 +1,158 @@
+// Codon usage and amino acid composition statistics.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "codonusage.h"
+#include "threadpool.h"
+
+// Bases per work item when counting a collection. A multiple of 3 so items never split a codon.
+static const size_t COUNT_BLOCK = 3 << 18;
+
+static const uint8_t FLAGS_AT = 0x5;
+static const uint8_t FLAGS_CG = 0xA;
+
+unsigned int CodonUsage::UnambiguousIndex(size_t i)
+{
+	return (1u << (i & 3)) | ((1u << ((i >> 2) & 3)) << 4) | ((1u << (i >> 4)) << 8);
+}
+
+void CodonUsage::Add(const NucleotideSequence& sequence, size_t start, size_t end, bool reverse_complement)
+{
+	assert(start <= end && end <= sequence.Length());
+
+	const char* p = sequence.cbegin();
+	size_t count = (end - start) / 3;
+	if (reverse_complement) {
+		for (const char* q = p + end; count; --count, q -= 3) {
+			++counts_[LookupTables::BaseFlagsComplement(q[-3])
+				| (LookupTables::BaseFlagsComplement(q[-2]) << 4)
+				| (LookupTables::BaseFlagsComplement(q[-1]) << 8)];
+		}
+	}
+	else {
+		for (const char* q = p + start; count; --count, q += 3)
+			++counts_[GeneticCodes::CodonIndex(q[0], q[1], q[2])];
+	}
+}
+
+void CodonUsage::Merge(const CodonUsage& other)
+{
+	for (size_t i = 0; i < counts_.size(); ++i)
+		counts_[i] += other.counts_[i];
+}
+
+void CodonUsage::Count(const std::vector<Region>& regions, CodonUsage* usage)
+{
+	// Long regions are split so that one large sequence doesn't leave the other threads idle.
+	std::vector<Region> items;
+	for (auto& region : regions) {
+		size_t length = region.end - region.start;
+		for (size_t done = 0; done < length; done += COUNT_BLOCK) {
+			size_t block = std::min(length - done, COUNT_BLOCK);
+			// Reverse codons are read from the end, so blocks are measured from there too.
+			if (region.reverse_complement)
+				items.push_back({ region.sequence, region.end - done - block, region.end - done, true });
+			else
+				items.push_back({ region.sequence, region.start + done, region.start + done + block, false });
+		}
+	}
+
+	ThreadPool& pool = ThreadPool::Instance();
+	size_t slices = std::min(items.size(), size_t(pool.ThreadCount()) * 4);
+	std::vector<CodonUsage> partial(slices);
+	pool.ForEach(slices, [&](size_t n) {
+		for (size_t i = n; i < items.size(); i += slices)
+			partial[n].Add(*items[i].sequence, items[i].start, items[i].end, items[i].reverse_complement);
+	});
+	for (auto& counts : partial)
+		usage->Merge(counts);
+}
+
+size_t CodonUsage::TotalCodons() const
+{
+	size_t total = 0;
+	for (size_t count : counts_)
+		total += count;
+	return total;
+}
+
+size_t CodonUsage::AmbiguousCodons() const
+{
+	size_t unambiguous = 0;
+	for (size_t i = 0; i < CODON_COUNT; ++i)
+		unambiguous += counts_[UnambiguousIndex(i)];
+	return TotalCodons() - unambiguous;
+}
+
+bool CodonUsage::AminoAcidComposition(size_t genetic_code, Composition* composition) const
+{
+	const char* table = GeneticCodes::AminoAcidTable(genetic_code);
+	if (!table)
+		return false;
+
+	composition->fill(0);
+	for (size_t i = 0; i < counts_.size(); ++i)
+		(*composition)[LookupTables::CharIndex(table[i])] += counts_[i];
+	return true;
+}
+
+double CodonUsage::GC3() const
+{
+	size_t gc = 0;
+	size_t at = 0;
+	for (size_t i = 0; i < counts_.size(); ++i) {
+		uint8_t third = i & 0xF;
+		if (third && (third & ~FLAGS_CG) == 0)
+			gc += counts_[i];
+		else if (third && (third & ~FLAGS_AT) == 0)
+			at += counts_[i];
+	}
+	return gc + at ? double(gc) / double(gc + at) : 0.0;
+}
+
+double CodonUsage::Cai(const CodonUsage& reference, size_t genetic_code) const
+{
+	const char* table = GeneticCodes::AminoAcidTable(genetic_code);
+	if (!table)
+		return 0.0;
+
+	// Relative adaptiveness is each codon's reference count over that of the most used synonymous codon.
+	Composition synonyms = {};
+	std::array<double, STOP_INDEX + 1> most_used = {};
+	for (size_t i = 0; i < CODON_COUNT; ++i) {
+		unsigned int index = UnambiguousIndex(i);
+		size_t aa = LookupTables::CharIndex(table[index]);
+		++synonyms[aa];
+		most_used[aa] = std::max(most_used[aa], std::max(double(reference.counts_[index]), 0.5));
+	}
+
+	double log_sum = 0.0;
+	size_t scored = 0;
+	for (size_t i = 0; i < CODON_COUNT; ++i) {
+		unsigned int index = UnambiguousIndex(i);
+		size_t aa = LookupTables::CharIndex(table[index]);
+		if (!counts_[index] || aa == STOP_INDEX || synonyms[aa] < 2)
+			continue;
+		double weight = std::max(double(reference.counts_[index]), 0.5) / most_used[aa];
+		log_sum += double(counts_[index]) * std::log(weight);
+		scored += counts_[index];
+	}
+	return scored ? std::exp(log_sum / double(scored)) : 0.0;
+}
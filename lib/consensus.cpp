@@ -0,0 +1,160 @@
+// Quality-weighted consensus of aligned reads.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cassert>
+#include "consensus.h"
+
+static const char CALL_BASES[] = "ACGT-N";
+
+Consensus::Consensus(const std::vector<AlignedRead>& reads)
+{
+	reads_.resize(reads.size());
+	size_t end = 0;
+	for (size_t i = 0; i < reads.size(); ++i) {
+		GetVotes(reads[i], &reads_[i]);
+		end = std::max(end, reads_[i].start + reads_[i].calls.size());
+	}
+	Resize(end);
+	for (auto& read_votes : reads_)
+		AddVotes(read_votes, 1);
+	CallColumns(0, end);
+}
+
+char Consensus::Call(size_t column) const
+{
+	return CALL_BASES[calls_[column]];
+}
+
+void Consensus::GetSequence(NucleotideSequence* consensus, std::vector<uint64_t>* discrepancies) const
+{
+	std::string bases;
+	std::vector<quality_type> quality;
+	discrepancies->clear();
+	for (size_t i = 0; i < calls_.size(); ++i) {
+		if (calls_[i] == GAP_INDEX)
+			continue;
+		size_t pos = bases.length();
+		if (pos % WORD_BITS == 0)
+			discrepancies->push_back(0);
+		if (against_[i])
+			discrepancies->back() |= uint64_t(1) << (pos % WORD_BITS);
+		bases.push_back(CALL_BASES[calls_[i]]);
+		quality.push_back(quality_[i]);
+	}
+	*consensus = NucleotideSequence(bases.cbegin(), bases.cend(), quality.cbegin(), quality.cend());
+}
+
+void Consensus::AddRead(const AlignedRead& aligned_read)
+{
+	reads_.emplace_back();
+	ReadVotes& read_votes = reads_.back();
+	GetVotes(aligned_read, &read_votes);
+	size_t last = read_votes.start + read_votes.calls.size();
+	Resize(std::max(last, ColumnCount()));
+	AddVotes(read_votes, 1);
+	CallColumns(read_votes.start, last);
+}
+
+void Consensus::UpdateRead(size_t index, size_t start, const std::string& aligned)
+{
+	ReadVotes& read_votes = reads_[index];
+	size_t first = std::min(read_votes.start, start);
+	size_t last = std::max(read_votes.start + read_votes.calls.size(), start + aligned.length());
+	AddVotes(read_votes, -1);
+	GetVotes(AlignedRead{ read_votes.read, start, aligned }, &read_votes);
+	Resize(std::max(last, ColumnCount()));
+	AddVotes(read_votes, 1);
+
+	// The alignment ends with the furthest read, which may now be shorter.
+	size_t end = 0;
+	for (auto& other : reads_)
+		end = std::max(end, other.start + other.calls.size());
+	Resize(end);
+	CallColumns(first, std::min(last, end));
+}
+
+void Consensus::GetVotes(const AlignedRead& aligned_read, ReadVotes* read_votes)
+{
+	const NucleotideSequence& read = *aligned_read.read;
+	size_t length = read.Length();
+	read_votes->read = aligned_read.read;
+	read_votes->start = aligned_read.start;
+	read_votes->calls.assign(aligned_read.aligned.length(), uint8_t(N_INDEX));
+	read_votes->quality.assign(aligned_read.aligned.length(), 0);
+	size_t i = 0;
+	for (size_t k = 0; k < aligned_read.aligned.length(); ++k) {
+		if (aligned_read.aligned[k] == '-') {
+			// A gap is as good as the bases either side of it.
+			if (!length)
+				continue;
+			read_votes->calls[k] = GAP_INDEX;
+			read_votes->quality[k] = i == 0 ? read.QualityOrDefault(0) : i == length ? read.QualityOrDefault(length - 1)
+				: std::min(read.QualityOrDefault(i - 1), read.QualityOrDefault(i));
+			continue;
+		}
+		assert(i < length);
+		if (i >= length)
+			break;
+		int vote = LookupTables::BaseCode(aligned_read.aligned[k]);
+		if (vote >= 0) {
+			read_votes->calls[k] = uint8_t(vote);
+			read_votes->quality[k] = read.QualityOrDefault(i);
+		}
+		++i;
+	}
+}
+
+void Consensus::AddVotes(const ReadVotes& read_votes, int32_t sign)
+{
+	for (size_t k = 0; k < read_votes.calls.size(); ++k) {
+		if (read_votes.calls[k] != N_INDEX)
+			votes_[read_votes.calls[k]][read_votes.start + k] += sign * read_votes.quality[k];
+	}
+}
+
+void Consensus::Resize(size_t end)
+{
+	for (auto& votes : votes_)
+		votes.resize(end, 0);
+	calls_.resize(end, uint8_t(N_INDEX));
+	quality_.resize(end, 0);
+	against_.resize(end, 0);
+}
+
+void Consensus::CallColumns(size_t first, size_t last)
+{
+	// Ties go to the first of A, C, G, T and gap.
+	for (size_t i = first; i < last; ++i) {
+		int32_t best = votes_[0][i];
+		int32_t total = best;
+		uint8_t call = 0;
+		for (uint8_t v = 1; v < VOTE_COUNT; ++v) {
+			int32_t votes = votes_[v][i];
+			bool higher = votes > best;
+			call = higher ? v : call;
+			best = higher ? votes : best;
+			total += votes;
+		}
+		int32_t against = total - best;
+		calls_[i] = best ? call : N_INDEX;
+		against_[i] = against;
+		quality_[i] = quality_type(std::min(std::max(best - against, 0), int32_t(MAX_QUALITY)));
+	}
+}
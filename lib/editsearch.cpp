@@ -0,0 +1,127 @@
+// Approximate search by edit distance.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// Uses the bit-parallel algorithm of Myers (1999), with the query split into blocks of 64 rows as described by
+// Hyyro (2003). Each column of the edit distance matrix is held as vertical +1 and -1 deltas, one bit per row.
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <memory>
+#include "align.h"
+
+// Number of distinct values returned by LookupTables::BaseFlags().
+static const size_t BASE_FLAG_COUNT = 16;
+
+static const size_t BLOCK_BITS = 64;
+
+class BitVectorPattern
+{
+public:
+	// If complement is set the pattern is the reverse complement of the query.
+	BitVectorPattern(const char* query, size_t length, bool complement)
+		: blocks_((length + BLOCK_BITS - 1) / BLOCK_BITS),
+		peq_(std::make_unique<uint64_t[]>(BASE_FLAG_COUNT * blocks_)),
+		pv_(std::make_unique<uint64_t[]>(blocks_)),
+		mv_(std::make_unique<uint64_t[]>(blocks_)),
+		last_bit_(uint64_t(1) << ((length - 1) % BLOCK_BITS)),
+		score_(int(length))
+	{
+		std::fill_n(peq_.get(), BASE_FLAG_COUNT * blocks_, 0);
+		for (size_t j = 0; j < length; ++j) {
+			uint8_t query_flags = complement ? LookupTables::BaseFlagsComplement(query[length - 1 - j]) : LookupTables::BaseFlags(query[j]);
+			// Same test as LookupTables::BaseMatch(): the query base must include every possibility of the sequence base.
+			for (uint8_t flags = 0; flags < BASE_FLAG_COUNT; ++flags) {
+				if ((flags & query_flags) == flags)
+					peq_[flags * blocks_ + j / BLOCK_BITS] |= uint64_t(1) << (j % BLOCK_BITS);
+			}
+		}
+		std::fill_n(pv_.get(), blocks_, ~uint64_t(0));
+		std::fill_n(mv_.get(), blocks_, 0);
+	}
+
+	// Advance by one sequence base and return the edit distance of the best match ending there.
+	int Step(uint8_t base_flags) {
+		const uint64_t* peq = peq_.get() + base_flags * blocks_;
+		// The top row is zero in every column, so a match can start anywhere.
+		int carry = 0;
+		for (size_t b = 0; b < blocks_; ++b) {
+			uint64_t pv = pv_[b];
+			uint64_t mv = mv_[b];
+			uint64_t eq = peq[b];
+			uint64_t xv = eq | mv;
+			if (carry < 0)
+				eq |= 1;
+			uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+			uint64_t ph = mv | ~(xh | pv);
+			uint64_t mh = pv & xh;
+			uint64_t high = b + 1 < blocks_ ? uint64_t(1) << (BLOCK_BITS - 1) : last_bit_;
+			int carry_out = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+			ph <<= 1;
+			mh <<= 1;
+			if (carry < 0)
+				mh |= 1;
+			else if (carry > 0)
+				ph |= 1;
+			pv_[b] = mh | ~(xv | ph);
+			mv_[b] = ph & xv;
+			carry = carry_out;
+		}
+		score_ += carry;
+		return score_;
+	}
+
+private:
+	size_t blocks_;
+	// Match masks for each value of the sequence base flags, blocks_ words each.
+	std::unique_ptr<uint64_t[]> peq_;
+	std::unique_ptr<uint64_t[]> pv_;
+	std::unique_ptr<uint64_t[]> mv_;
+	// The bit of the last block which holds the final row. Bits above it are padding and never affect it.
+	uint64_t last_bit_;
+	int score_;
+};
+
+void Alignment::EditSearch(const NucleotideSequence& sequence, size_t start, size_t end, const char* query, int max_errors, bool both_strands, std::vector<EditHit>* hits)
+{
+	assert(start <= end && end <= sequence.Length());
+
+	size_t length = strlen(query);
+	if (!length || max_errors < 0)
+		return;
+
+	BitVectorPattern forward(query, length, false);
+	if (!both_strands) {
+		for (size_t i = start; i < end; ++i) {
+			int errors = forward.Step(LookupTables::BaseFlags(sequence[i]));
+			if (errors <= max_errors)
+				hits->push_back({ i + 1, errors, false });
+		}
+		return;
+	}
+
+	BitVectorPattern reverse(query, length, true);
+	for (size_t i = start; i < end; ++i) {
+		uint8_t flags = LookupTables::BaseFlags(sequence[i]);
+		int errors = forward.Step(flags);
+		if (errors <= max_errors)
+			hits->push_back({ i + 1, errors, false });
+		errors = reverse.Step(flags);
+		if (errors <= max_errors)
+			hits->push_back({ i + 1, errors, true });
+	}
+}
@@ -17,6 +17,7 @@
 // You should have received a copy of the GNU General Public License
 // along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -24,10 +25,107 @@
 #include "strutil.h"
 #include "system.h"
 
-GeneticCodes::static_initializer GeneticCodes::impl_;
-static const char standard_code[] = "Standard; FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG ---M---------------M---------------M";
+// A genetic code in the compact form of the NCBI translation tables, with codons in TCAG order and 'M' marking
+// start codons. Converted to codons at compile time.
+struct BuiltinCode
+{
+	const char* name;
+	GeneticCodes::Codon codons[64];
 
-static const size_t CODON_COUNT = 64;
+	constexpr BuiltinCode(const char* name_, const char* amino_acids, const char* starts)
+		: name(name_), codons{}
+	{
+		for (size_t i = 0; i < 64; ++i) {
+			codons[i].amino_acid = amino_acids[i];
+			codons[i].can_start = starts[i] == 'M';
+		}
+	}
+};
+
+// NCBI translation tables 1-6, 9-16 and 21-33, in order. The standard code must be first.
+static constexpr BuiltinCode builtin_codes[] = {
+	{ "Standard",
+		"FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"---M------**--*----M---------------M----------------------------" },
+	{ "Vertebrate Mitochondrial",
+		"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSS**VVVVAAAADDEEGGGG",
+		"----------**--------------------MMMM----------**---M------------" },
+	{ "Yeast Mitochondrial",
+		"FFLLSSSSYY**CCWWTTTTPPPPHHQQRRRRIIMMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------**----------------------MM---------------M------------" },
+	{ "Mold, Protozoan, and Coelenterate Mitochondrial and Mycoplasma/Spiroplasma",
+		"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"--MM------**-------M------------MMMM---------------M------------" },
+	{ "Invertebrate Mitochondrial",
+		"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSSSVVVVAAAADDEEGGGG",
+		"---M------**--------------------MMMM---------------M------------" },
+	{ "Ciliate, Dasycladacean and Hexamita Nuclear",
+		"FFLLSSSSYYQQCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"--------------*--------------------M----------------------------" },
+	{ "Echinoderm and Flatworm Mitochondrial",
+		"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG",
+		"----------**-----------------------M---------------M------------" },
+	{ "Euplotid Nuclear",
+		"FFLLSSSSYY**CCCWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------**-----------------------M----------------------------" },
+	{ "Bacterial, Archaeal and Plant Plastid",
+		"FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"---M------**--*----M------------MMMM---------------M------------" },
+	{ "Alternative Yeast Nuclear",
+		"FFLLSSSSYY**CC*WLLLSPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------**--*----M---------------M----------------------------" },
+	{ "Ascidian Mitochondrial",
+		"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNKKSSGGVVVVAAAADDEEGGGG",
+		"---M------**----------------------MM---------------M------------" },
+	{ "Alternative Flatworm Mitochondrial",
+		"FFLLSSSSYYY*CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNNKSSSSVVVVAAAADDEEGGGG",
+		"-----------*-----------------------M----------------------------" },
+	{ "Blepharisma Macronuclear",
+		"FFLLSSSSYY*QCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------*---*--------------------M----------------------------" },
+	{ "Chlorophycean Mitochondrial",
+		"FFLLSSSSYY*LCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------*---*--------------------M----------------------------" },
+	{ "Trematode Mitochondrial",
+		"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIMMTTTTNNNKSSSSVVVVAAAADDEEGGGG",
+		"----------**-----------------------M---------------M------------" },
+	{ "Scenedesmus obliquus Mitochondrial",
+		"FFLLSS*SYY*LCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"------*---*---*--------------------M----------------------------" },
+	{ "Thraustochytrium Mitochondrial",
+		"FF*LSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"--*-------**--*-----------------M--M---------------M------------" },
+	{ "Rhabdopleuridae Mitochondrial",
+		"FFLLSSSSYY**CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSSKVVVVAAAADDEEGGGG",
+		"---M------**-------M---------------M---------------M------------" },
+	{ "Candidate Division SR1 and Gracilibacteria",
+		"FFLLSSSSYY**CCGWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"---M------**-----------------------M---------------M------------" },
+	{ "Pachysolen tannophilus Nuclear",
+		"FFLLSSSSYY**CC*WLLLAPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------**--*----M---------------M----------------------------" },
+	{ "Karyorelict Nuclear",
+		"FFLLSSSSYYQQCCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"--------------*--------------------M----------------------------" },
+	{ "Condylostoma Nuclear",
+		"FFLLSSSSYYQQCCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------**--*--------------------M----------------------------" },
+	{ "Mesodinium Nuclear",
+		"FFLLSSSSYYYYCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"--------------*--------------------M----------------------------" },
+	{ "Peritrich Nuclear",
+		"FFLLSSSSYYEECC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"--------------*--------------------M----------------------------" },
+	{ "Blastocrithidia Nuclear",
+		"FFLLSSSSYYEECCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"----------**-----------------------M----------------------------" },
+	{ "Balanophoraceae Plastid",
+		"FFLLSSSSYY*WCC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG",
+		"---M------*---*----M------------MMMM---------------M------------" },
+	{ "Cephalodiscidae Mitochondrial",
+		"FFLLSSSSYYY*CCWWLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSSKVVVVAAAADDEEGGGG",
+		"---M-------*-------M---------------M---------------M------------" },
+};
 
 static size_t CodonIndexToFlags(size_t index)
 {
@@ -44,8 +142,17 @@ static bool CodonIndexMatch(size_t index, size_t flags)
 	return (i & flags) == i;
 }
 
+GeneticCodes::CodonTable::CodonTable(const char* name_, const Codon* codons_)
+	: name(name_),
+	expanded(false)
+{
+	std::copy_n(codons_, CODON_COUNT, codons.begin());
+}
+
 GeneticCodes::CodonTable::CodonTable(const char* line)
+	: expanded(false)
 {
+	codons.fill({ AA_UNKNOWN, false });
 	const char* p = strchr(line, ';');
 	if (!p)
 		return;
@@ -55,7 +162,6 @@ GeneticCodes::CodonTable::CodonTable(const char* line)
 		return;
 	name.assign(line, i);
 	p = SkipSpaces(p + 1);
-	std::array<Codon, CODON_COUNT> codons;
 	for (i = 0; i < CODON_COUNT; ++i) {
 		char aa = LookupTables::Uppercase(p[i]);
 		if (aa != '*' && (aa < 'A' || aa > 'Z'))
@@ -67,13 +173,18 @@ GeneticCodes::CodonTable::CodonTable(const char* line)
 		p = SkipSpaces(p);
 		for (i = 0; i < 64; ++i) {
 			char c = LookupTables::Uppercase(p[i]);
-			if (c != '-' && c != 'M')
+			// Newer NCBI tables also mark stop codons.
+			if (c != '-' && c != 'M' && c != '*')
 				break;
 			codons[i].can_start = (c == 'M');
 		}
 		for (; i < 64; ++i)
 			codons[i].can_start = false;
 	}
+}
+
+void GeneticCodes::CodonTable::Expand()
+{
 	for (size_t i = 0; i < TABLE_SIZE; ++i) {
 		unsigned int aa_flags = 0;
 		size_t aa_index = 0;
@@ -85,7 +196,12 @@ GeneticCodes::CodonTable::CodonTable(const char* line)
 				aa_index = j;
 			}
 		}
-		if ((aa_flags & (aa_flags - 1)) == 0) {
+		if (aa_flags == 0) {
+			// A base matches nothing, as for gaps.
+			table[i].amino_acid = AA_UNKNOWN;
+			can_start = false;
+		}
+		else if ((aa_flags & (aa_flags - 1)) == 0) {
 			table[i] = codons[aa_index];
 		}
 		else if (aa_flags == ((1 << LookupTables::CharIndex('D')) | (1 << LookupTables::CharIndex('N')))) {
@@ -98,39 +214,101 @@ GeneticCodes::CodonTable::CodonTable(const char* line)
 			table[i].amino_acid = AA_UNKNOWN;
 		}
 		table[i].can_start = can_start;
+		amino_acids[i] = table[i].amino_acid;
 	}
 }
 
+template<typename T>
+void GeneticCodes::TranslateBlocks(const char* sequence, size_t start, size_t end, bool reverse_complement, const T* table, T* out)
+{
+	size_t count = (end - start) / 3;
+	uint16_t index[TRANSLATE_BLOCK];
+	for (size_t done = 0; done < count; done += TRANSLATE_BLOCK) {
+		size_t block = std::min(count - done, size_t(TRANSLATE_BLOCK));
+		// Build the 12-bit table indexes first, then gather, so neither loop has a dependency between codons.
+		if (reverse_complement) {
+			const char* p = sequence + end - 3 * done;
+			for (size_t k = 0; k < block; ++k, p -= 3) {
+				index[k] = uint16_t(LookupTables::BaseFlagsComplement(p[-3])
+					| (LookupTables::BaseFlagsComplement(p[-2]) << 4)
+					| (LookupTables::BaseFlagsComplement(p[-1]) << 8));
+			}
+		}
+		else {
+			const char* p = sequence + start + 3 * done;
+			for (size_t k = 0; k < block; ++k, p += 3) {
+				index[k] = uint16_t(LookupTables::BaseFlags(p[2])
+					| (LookupTables::BaseFlags(p[1]) << 4)
+					| (LookupTables::BaseFlags(p[0]) << 8));
+			}
+		}
+		for (size_t k = 0; k < block; ++k)
+			out[done + k] = table[index[k]];
+	}
+}
+
+size_t GeneticCodes::Translate(const char* sequence, size_t start, size_t end, bool reverse_complement, size_t genetic_code, char* amino_acids)
+{
+	assert(start <= end);
+	assert(genetic_code < Tables().size());
+
+	size_t count = (end - start) / 3;
+	if (genetic_code >= Tables().size())
+		std::fill_n(amino_acids, count, char(AA_UNKNOWN));
+	else
+		TranslateBlocks(sequence, start, end, reverse_complement, ExpandedTable(*Tables()[genetic_code]).amino_acids.data(), amino_acids);
+	return count;
+}
+
+size_t GeneticCodes::TranslateCodons(const char* sequence, size_t start, size_t end, bool reverse_complement, size_t genetic_code, Codon* codons)
+{
+	assert(start <= end);
+	assert(genetic_code < Tables().size());
+
+	size_t count = (end - start) / 3;
+	if (genetic_code >= Tables().size())
+		std::fill_n(codons, count, Codon{ AA_UNKNOWN, false });
+	else
+		TranslateBlocks(sequence, start, end, reverse_complement, ExpandedTable(*Tables()[genetic_code]).table.data(), codons);
+	return count;
+}
+
+const char* GeneticCodes::AminoAcidTable(size_t genetic_code)
+{
+	if (genetic_code >= Tables().size())
+		return nullptr;
+	return ExpandedTable(*Tables()[genetic_code]).amino_acids.data();
+}
+
 int GeneticCodes::Search(const char* name)
 {
-    for (size_t i = 0; i < impl_.codon_tables.size(); ++i)
-        if (impl_.codon_tables[i].name.compare(name) == 0)
+    for (size_t i = 0; i < Tables().size(); ++i)
+        if (Tables()[i]->name.compare(name) == 0)
             return (int)i;
     return -1;
 }
 
-void GeneticCodes::Initialize()
+GeneticCodes::Registry::Registry()
 {
     std::string path = System::ProgramDataDir();
     System::AppendName(path, "geneticcodes");
 
+    // The file is optional, and replaces the built-in tables if present.
     std::ifstream stream(path);
-    if (stream.fail()) {
-        std::cerr << "Genetic code file not found; loading standard code only." << std::endl;
-		impl_.codon_tables.emplace_back(standard_code);
-        return;
+    if (!stream.fail()) {
+        do {
+            std::string line;
+            std::getline(stream, line);
+            if (stream.fail()) {
+                std::cerr << "Error reading genetic code file; only " << codon_tables.size() << " table(s) loaded." << std::endl;
+                break;
+            }
+            codon_tables.push_back(std::make_unique<CodonTable>(line.c_str()));
+        } while (!stream.eof());
     }
 
-    do {
-        std::string line;
-        std::getline(stream, line);
-        if (stream.fail()) {
-            std::cerr << "Error reading genetic code file; only " << impl_.codon_tables.size() << " table(s) loaded." << std::endl;
-            break;
-        }
-		impl_.codon_tables.emplace_back(line.c_str());
-    } while (!stream.eof());
-
-    if (impl_.codon_tables.empty())
-		impl_.codon_tables.emplace_back(standard_code);
+    if (codon_tables.empty()) {
+        for (auto& code : builtin_codes)
+            codon_tables.push_back(std::make_unique<CodonTable>(code.name, code.codons));
+    }
 }
@@ -0,0 +1,206 @@
+// K-mer sketches of sequences for fast similarity estimates.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <unordered_map>
+#include "kmersketch.h"
+#include "threadpool.h"
+
+KmerSketch::KmerSketch()
+	: kmer_length_(0),
+	limit_(0)
+{
+}
+
+void KmerSketch::CanonicalKmers(const NucleotideSequence& sequence, size_t kmer_length, std::vector<uint64_t>* kmers)
+{
+	assert(kmer_length > 0 && kmer_length <= MAX_KMER_LENGTH);
+	const uint64_t mask = kmer_length < MAX_KMER_LENGTH ? (uint64_t(1) << (kmer_length * 2)) - 1 : ~uint64_t(0);
+	const size_t top_shift = (kmer_length - 1) * 2;
+	// The k-mer and its reverse complement are rolled along together, one base at a time.
+	uint64_t forward = 0;
+	uint64_t reverse = 0;
+	size_t valid = 0;
+	for (size_t i = 0; i < sequence.Length(); ++i) {
+		int code = LookupTables::BaseCode(sequence[i]);
+		if (code < 0) {
+			valid = 0;
+			continue;
+		}
+		forward = ((forward << 2) | uint64_t(code)) & mask;
+		reverse = (reverse >> 2) | (uint64_t(3 - code) << top_shift);
+		if (++valid >= kmer_length)
+			kmers->push_back(std::min(forward, reverse));
+	}
+}
+
+uint64_t KmerSketch::Hash(uint64_t kmer)
+{
+	// The MurmurHash3 finalizer.
+	kmer ^= kmer >> 33;
+	kmer *= 0xFF51AFD7ED558CCDULL;
+	kmer ^= kmer >> 33;
+	kmer *= 0xC4CEB9FE1A85EC53ULL;
+	kmer ^= kmer >> 33;
+	return kmer;
+}
+
+void KmerSketch::BuildMinHash(const NucleotideSequence& sequence, size_t kmer_length, size_t sketch_size)
+{
+	kmer_length_ = kmer_length;
+	HashKmers(sequence, kmer_length, &hashes_);
+	if (hashes_.size() > sketch_size) {
+		hashes_.resize(sketch_size);
+		limit_ = sketch_size ? hashes_.back() : 0;
+	}
+	else {
+		// Every k-mer is in the sketch.
+		limit_ = std::numeric_limits<uint64_t>::max();
+	}
+}
+
+void KmerSketch::BuildFracMinHash(const NucleotideSequence& sequence, size_t kmer_length, uint64_t scale)
+{
+	kmer_length_ = kmer_length;
+	limit_ = scale > 1 ? std::numeric_limits<uint64_t>::max() / scale : std::numeric_limits<uint64_t>::max();
+	HashKmers(sequence, kmer_length, &hashes_);
+	hashes_.erase(std::upper_bound(hashes_.begin(), hashes_.end(), limit_), hashes_.end());
+}
+
+double KmerSketch::Jaccard(const KmerSketch& other) const
+{
+	size_t own_count;
+	size_t other_count;
+	size_t shared_count;
+	Compare(other, &own_count, &other_count, &shared_count);
+	size_t union_count = own_count + other_count - shared_count;
+	return union_count ? double(shared_count) / double(union_count) : 0.0;
+}
+
+double KmerSketch::Containment(const KmerSketch& other) const
+{
+	size_t own_count;
+	size_t other_count;
+	size_t shared_count;
+	Compare(other, &own_count, &other_count, &shared_count);
+	return own_count ? double(shared_count) / double(own_count) : 0.0;
+}
+
+void KmerSketch::Assign(const KmerSketch* reads, size_t read_count, const KmerSketch* references, size_t reference_count, double min_containment, std::vector<size_t>* assignments)
+{
+	// Index the references by hash, so each read is compared only with references it shares a hash with.
+	std::vector<std::pair<uint64_t, size_t>> index;
+	for (size_t r = 0; r < reference_count; ++r) {
+		for (uint64_t hash : references[r].hashes_)
+			index.emplace_back(hash, r);
+	}
+	std::sort(index.begin(), index.end());
+
+	assignments->assign(read_count, size_t(NOT_FOUND));
+	ThreadPool::Instance().ForEach(read_count, [&](size_t i) {
+		std::vector<size_t> candidates;
+		for (uint64_t hash : reads[i].hashes_) {
+			auto first = std::lower_bound(index.cbegin(), index.cend(), std::make_pair(hash, size_t(0)));
+			for (auto entry = first; entry != index.cend() && entry->first == hash; ++entry)
+				candidates.push_back(entry->second);
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+		double best = min_containment;
+		for (size_t r : candidates) {
+			double containment = reads[i].Containment(references[r]);
+			if (containment >= best && ((*assignments)[i] == NOT_FOUND || containment > best)) {
+				(*assignments)[i] = r;
+				best = containment;
+			}
+		}
+	});
+}
+
+void KmerSketch::Cluster(const KmerSketch* sketches, size_t count, double min_jaccard, std::vector<size_t>* clusters)
+{
+	// The clusters whose first member has each hash. Clusters are added in order, so each list is sorted.
+	std::unordered_map<uint64_t, std::vector<size_t>> index;
+	std::vector<size_t> firsts;
+	clusters->assign(count, size_t(NOT_FOUND));
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < count; ++i) {
+		candidates.clear();
+		for (uint64_t hash : sketches[i].hashes_) {
+			auto entry = index.find(hash);
+			if (entry != index.end())
+				candidates.insert(candidates.end(), entry->second.cbegin(), entry->second.cend());
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+		double best = min_jaccard;
+		for (size_t c : candidates) {
+			double jaccard = sketches[i].Jaccard(sketches[firsts[c]]);
+			if (jaccard >= best && ((*clusters)[i] == NOT_FOUND || jaccard > best)) {
+				(*clusters)[i] = c;
+				best = jaccard;
+			}
+		}
+		if ((*clusters)[i] != NOT_FOUND)
+			continue;
+
+		// A new cluster, whose hashes are added to the index.
+		size_t cluster = firsts.size();
+		(*clusters)[i] = cluster;
+		firsts.push_back(i);
+		for (uint64_t hash : sketches[i].hashes_)
+			index[hash].push_back(cluster);
+	}
+}
+
+void KmerSketch::Compare(const KmerSketch& other, size_t* own_count, size_t* other_count, size_t* shared_count) const
+{
+	assert(kmer_length_ == other.kmer_length_ || hashes_.empty() || other.hashes_.empty());
+	uint64_t limit = std::min(limit_, other.limit_);
+	auto own_end = std::upper_bound(hashes_.cbegin(), hashes_.cend(), limit);
+	auto other_end = std::upper_bound(other.hashes_.cbegin(), other.hashes_.cend(), limit);
+	*own_count = size_t(own_end - hashes_.cbegin());
+	*other_count = size_t(other_end - other.hashes_.cbegin());
+	*shared_count = 0;
+	for (auto own = hashes_.cbegin(), theirs = other.hashes_.cbegin(); own != own_end && theirs != other_end;) {
+		if (*own < *theirs) {
+			++own;
+		}
+		else if (*theirs < *own) {
+			++theirs;
+		}
+		else {
+			++*shared_count;
+			++own;
+			++theirs;
+		}
+	}
+}
+
+void KmerSketch::HashKmers(const NucleotideSequence& sequence, size_t kmer_length, std::vector<uint64_t>* hashes)
+{
+	hashes->clear();
+	CanonicalKmers(sequence, kmer_length, hashes);
+	for (auto& hash : *hashes)
+		hash = Hash(hash);
+	std::sort(hashes->begin(), hashes->end());
+	hashes->erase(std::unique(hashes->begin(), hashes->end()), hashes->end());
+}
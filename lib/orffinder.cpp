@@ -0,0 +1,119 @@
+// Open reading frame detection.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <memory>
+#include "orffinder.h"
+#include "geneticcodes.h"
+#include "threadpool.h"
+
+static const size_t FRAME_COUNT = 3;
+
+// Number of complete codons in a frame.
+static size_t CodonCount(size_t length, size_t frame)
+{
+	return length > frame ? (length - frame) / 3 : 0;
+}
+
+void OrfFinder::Find(const NucleotideSequence& sequence, size_t genetic_code, size_t min_codons, bool alternative_starts, std::vector<Orf>* orfs)
+{
+	orfs->clear();
+	size_t length = sequence.Length();
+
+	// Chunks of all six frames are scanned independently, then joined in reading order.
+	size_t chunk_start[FRAME_COUNT * 2 + 1];
+	chunk_start[0] = 0;
+	for (size_t i = 0; i < FRAME_COUNT * 2; ++i)
+		chunk_start[i + 1] = chunk_start[i] + (CodonCount(length, i % FRAME_COUNT) + CHUNK_CODONS - 1) / CHUNK_CODONS;
+	std::vector<Chunk> chunks(chunk_start[FRAME_COUNT * 2]);
+	ThreadPool::Instance().ForEach(chunks.size(), [&](size_t n) {
+		size_t i = std::upper_bound(chunk_start, chunk_start + FRAME_COUNT * 2 + 1, n) - chunk_start - 1;
+		size_t frame = i % FRAME_COUNT;
+		size_t first = (n - chunk_start[i]) * CHUNK_CODONS;
+		size_t last = std::min(first + CHUNK_CODONS, CodonCount(length, frame));
+		ScanChunk(sequence, genetic_code, alternative_starts, frame, i >= FRAME_COUNT, first, last, &chunks[n]);
+	});
+
+	for (size_t i = 0; i < FRAME_COUNT * 2; ++i) {
+		size_t frame = i % FRAME_COUNT;
+		bool reverse = i >= FRAME_COUNT;
+		size_t frame_end = frame + CodonCount(length, frame) * 3;
+		auto add = [&](size_t start_codon, size_t stop_codon) {
+			if (stop_codon - start_codon < min_codons)
+				return;
+			if (reverse)
+				orfs->push_back({ frame_end - 3 * (stop_codon + 1), frame_end - 3 * start_codon, true });
+			else
+				orfs->push_back({ frame + 3 * start_codon, frame + 3 * (stop_codon + 1), false });
+		};
+
+		// The first start codon since the last stop, carried across chunks with no stop.
+		size_t open_start = NONE;
+		for (size_t n = chunk_start[i]; n < chunk_start[i + 1]; ++n) {
+			const Chunk& chunk = chunks[n];
+			if (chunk.first_stop == NONE) {
+				if (open_start == NONE)
+					open_start = chunk.open_start;
+				continue;
+			}
+			size_t start_codon = open_start != NONE ? open_start : chunk.first_start;
+			if (start_codon != NONE)
+				add(start_codon, chunk.first_stop);
+			for (auto& orf : chunk.orfs)
+				add(orf.first, orf.second);
+			open_start = chunk.open_start;
+		}
+	}
+
+	std::sort(orfs->begin(), orfs->end(), [](const Orf& x, const Orf& y) {
+		return x.start < y.start || (x.start == y.start && x.end < y.end);
+	});
+}
+
+void OrfFinder::ScanChunk(const NucleotideSequence& sequence, size_t genetic_code, bool alternative_starts, size_t frame, bool reverse, size_t first, size_t last, Chunk* chunk)
+{
+	auto codons = std::make_unique<GeneticCodes::Codon[]>(last - first);
+	if (reverse) {
+		size_t frame_end = frame + CodonCount(sequence.Length(), frame) * 3;
+		GeneticCodes::TranslateCodons(sequence.cbegin(), frame_end - last * 3, frame_end - first * 3, true, genetic_code, codons.get());
+	}
+	else {
+		GeneticCodes::TranslateCodons(sequence.cbegin(), frame + first * 3, frame + last * 3, false, genetic_code, codons.get());
+	}
+
+	chunk->first_stop = NONE;
+	chunk->first_start = NONE;
+	size_t open_start = NONE;
+	for (size_t k = 0; k < last - first; ++k) {
+		const GeneticCodes::Codon& codon = codons[k];
+		if (open_start == NONE && codon.can_start && (alternative_starts || codon.amino_acid == 'M'))
+			open_start = first + k;
+		if (codon.amino_acid == '*') {
+			if (chunk->first_stop == NONE) {
+				chunk->first_stop = first + k;
+				chunk->first_start = open_start;
+			}
+			else if (open_start != NONE) {
+				chunk->orfs.emplace_back(open_start, first + k);
+			}
+			open_start = NONE;
+		}
+	}
+	chunk->open_start = open_start;
+}
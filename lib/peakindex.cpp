@@ -0,0 +1,164 @@
+// Index of the trace peaks of a sequence for finding the bases at trace samples.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <limits>
+#include "peakindex.h"
+
+using peak_type = PeakIndex::peak_type;
+
+// An empty range has its lowest peak above its highest, so it overlaps nothing.
+static const peak_type NO_LOWEST = std::numeric_limits<peak_type>::max();
+static const peak_type NO_HIGHEST = std::numeric_limits<peak_type>::min();
+
+PeakIndex::PeakIndex(const NucleotideSequence& sequence)
+	: sequence_(sequence)
+{
+	Refresh();
+}
+
+size_t PeakIndex::NearestBase(peak_type sample) const
+{
+	size_t base = NOT_FOUND;
+	int64_t distance = std::numeric_limits<int64_t>::max();
+	Nearest(1, sample, &base, &distance);
+	return base;
+}
+
+bool PeakIndex::BasesInWindow(peak_type start, peak_type end, size_t* first_base, size_t* last_base) const
+{
+	*first_base = FindFirst(1, start, end);
+	if (*first_base == NOT_FOUND)
+		return false;
+	*last_base = FindLast(1, start, end);
+	return true;
+}
+
+void PeakIndex::Update(size_t pos, size_t old_length, size_t new_length)
+{
+	size_t length = PeakCount();
+	if (length > leaf_count_) {
+		Refresh();
+		return;
+	}
+	// A change of length moves every later base, and clears the leaves beyond the new end. Bases beyond the last
+	// peak have no leaves.
+	size_t last = std::min(old_length == new_length ? pos + new_length : std::max(length, length_), leaf_count_);
+	pos = std::min(pos, last);
+	length_ = length;
+	SetLeaves(pos, last);
+	UpdateParents(pos, last);
+}
+
+void PeakIndex::Refresh()
+{
+	length_ = PeakCount();
+	leaf_count_ = 1;
+	while (leaf_count_ < length_)
+		leaf_count_ *= 2;
+	lowest_.assign(leaf_count_ * 2, NO_LOWEST);
+	highest_.assign(leaf_count_ * 2, NO_HIGHEST);
+	SetLeaves(0, length_);
+	UpdateParents(0, leaf_count_);
+}
+
+size_t PeakIndex::PeakCount() const
+{
+	if (!sequence_.HasTraces())
+		return 0;
+	return std::min(sequence_.Length(), size_t(sequence_.PeakEnd() - sequence_.PeakBegin()));
+}
+
+void PeakIndex::SetLeaves(size_t first, size_t last)
+{
+	const peak_type* peaks = sequence_.PeakBegin();
+	for (size_t i = first; i < last; ++i) {
+		bool present = i < length_;
+		lowest_[leaf_count_ + i] = present ? peaks[i] : NO_LOWEST;
+		highest_[leaf_count_ + i] = present ? peaks[i] : NO_HIGHEST;
+	}
+}
+
+void PeakIndex::UpdateParents(size_t first, size_t last)
+{
+	if (first >= last)
+		return;
+	// Work up a level at a time over the parents of the changed nodes.
+	size_t low = (leaf_count_ + first) / 2;
+	size_t high = (leaf_count_ + last - 1) / 2;
+	for (; low >= 1; low /= 2, high /= 2) {
+		for (size_t node = low; node <= high; ++node) {
+			lowest_[node] = std::min(lowest_[node * 2], lowest_[node * 2 + 1]);
+			highest_[node] = std::max(highest_[node * 2], highest_[node * 2 + 1]);
+		}
+	}
+}
+
+int64_t PeakIndex::LowerBound(size_t node, peak_type sample) const
+{
+	if (lowest_[node] > highest_[node])
+		return std::numeric_limits<int64_t>::max();
+	if (sample < lowest_[node])
+		return int64_t(lowest_[node]) - sample;
+	if (sample > highest_[node])
+		return int64_t(sample) - highest_[node];
+	return 0;
+}
+
+void PeakIndex::Nearest(size_t node, peak_type sample, size_t* base, int64_t* distance) const
+{
+	int64_t bound = LowerBound(node, sample);
+	if (bound == std::numeric_limits<int64_t>::max() || bound > *distance)
+		return;
+	if (node >= leaf_count_) {
+		size_t i = node - leaf_count_;
+		if (bound < *distance || i < *base) {
+			*base = i;
+			*distance = bound;
+		}
+		return;
+	}
+	// The more promising child first, so that the other can usually be skipped.
+	size_t left = node * 2;
+	size_t right = left + 1;
+	if (LowerBound(right, sample) < LowerBound(left, sample))
+		std::swap(left, right);
+	Nearest(left, sample, base, distance);
+	Nearest(right, sample, base, distance);
+}
+
+size_t PeakIndex::FindFirst(size_t node, peak_type start, peak_type end) const
+{
+	if (!Overlaps(node, start, end))
+		return NOT_FOUND;
+	if (node >= leaf_count_)
+		return node - leaf_count_;
+	size_t base = FindFirst(node * 2, start, end);
+	return base != NOT_FOUND ? base : FindFirst(node * 2 + 1, start, end);
+}
+
+size_t PeakIndex::FindLast(size_t node, peak_type start, peak_type end) const
+{
+	if (!Overlaps(node, start, end))
+		return NOT_FOUND;
+	if (node >= leaf_count_)
+		return node - leaf_count_;
+	size_t base = FindLast(node * 2 + 1, start, end);
+	return base != NOT_FOUND ? base : FindLast(node * 2, start, end);
+}
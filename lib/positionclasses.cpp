@@ -0,0 +1,205 @@
+// Bitmaps of the positions of a sequence which need attention.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cassert>
+#include "positionclasses.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Quality values below this mean none was recorded.
+static const int MIN_QUALITY = 2;
+
+static unsigned int LowestBit(uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward64(&i, word);
+	return i;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+static unsigned int HighestBit(uint64_t word)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanReverse64(&i, word);
+	return i;
+#else
+	return 63 - __builtin_clzll(word);
+#endif
+}
+
+// Bits [lo, hi) of a word, where hi may be 64.
+static uint64_t RangeMask(size_t lo, size_t hi)
+{
+	uint64_t below_hi = hi < 64 ? (uint64_t(1) << hi) - 1 : ~uint64_t(0);
+	return below_hi & (~uint64_t(0) << lo);
+}
+
+// The 64 bits starting at pos, with zeros beyond the end of the bitmap.
+static uint64_t ReadBits(const std::vector<uint64_t>& bits, size_t pos)
+{
+	size_t i = pos / 64;
+	size_t shift = pos % 64;
+	uint64_t value = i < bits.size() ? bits[i] >> shift : 0;
+	if (shift && i + 1 < bits.size())
+		value |= bits[i + 1] << (64 - shift);
+	return value;
+}
+
+// OR count bits from src into dst, a word at a time.
+static void CopyBits(std::vector<uint64_t>& dst, size_t dst_pos, const std::vector<uint64_t>& src, size_t src_pos, size_t count)
+{
+	while (count) {
+		size_t shift = dst_pos % 64;
+		size_t n = std::min(count, 64 - shift);
+		dst[dst_pos / 64] |= (ReadBits(src, src_pos) & RangeMask(0, n)) << shift;
+		dst_pos += n;
+		src_pos += n;
+		count -= n;
+	}
+}
+
+PositionClasses::PositionClasses(const NucleotideSequence& sequence, int low_quality)
+	: sequence_(sequence),
+	low_quality_(low_quality),
+	length_(0)
+{
+	Refresh();
+}
+
+bool PositionClasses::Is(size_t pos, unsigned int classes) const
+{
+	assert(pos < length_);
+	return (Word(pos / WORD_BITS, classes) >> (pos % WORD_BITS)) & 1;
+}
+
+size_t PositionClasses::FindNext(size_t start_pos, unsigned int classes) const
+{
+	if (start_pos >= length_)
+		return NOT_FOUND;
+	size_t i = start_pos / WORD_BITS;
+	uint64_t word = Word(i, classes) & RangeMask(start_pos % WORD_BITS, WORD_BITS);
+	while (!word) {
+		if (++i >= bits_[0].size())
+			return NOT_FOUND;
+		word = Word(i, classes);
+	}
+	return i * WORD_BITS + LowestBit(word);
+}
+
+size_t PositionClasses::FindPrevious(size_t end_pos, unsigned int classes) const
+{
+	end_pos = std::min(end_pos, length_);
+	if (!end_pos)
+		return NOT_FOUND;
+	size_t last = end_pos - 1;
+	size_t i = last / WORD_BITS;
+	uint64_t word = Word(i, classes) & RangeMask(0, last % WORD_BITS + 1);
+	while (!word) {
+		if (i-- == 0)
+			return NOT_FOUND;
+		word = Word(i, classes);
+	}
+	return i * WORD_BITS + HighestBit(word);
+}
+
+void PositionClasses::Update(size_t pos, size_t old_length, size_t new_length)
+{
+	size_t length = sequence_.Length();
+	assert(pos + old_length <= length_ && length == length_ - old_length + new_length);
+	size_t tail = length_ - pos - old_length;
+
+	// Bits after the edit are moved, and those before it copied, without reclassifying the bases.
+	for (auto& bits : bits_) {
+		std::vector<uint64_t> updated(WordCount(length));
+		CopyBits(updated, 0, bits, 0, pos);
+		CopyBits(updated, pos + new_length, bits, pos + old_length, tail);
+		bits.swap(updated);
+	}
+	length_ = length;
+	Classify(pos, pos + new_length);
+	std::vector<uint64_t>& edited = bits_[EDITED_INDEX];
+	for (size_t i = pos / WORD_BITS; i * WORD_BITS < pos + new_length; ++i) {
+		size_t word_start = i * WORD_BITS;
+		edited[i] |= RangeMask(std::max(pos, word_start) - word_start, std::min(pos + new_length - word_start, size_t(WORD_BITS)));
+	}
+}
+
+void PositionClasses::Refresh()
+{
+	length_ = sequence_.Length();
+	for (auto& bits : bits_)
+		bits.assign(WordCount(length_), 0);
+	Classify(0, length_);
+}
+
+void PositionClasses::SetLowQuality(int low_quality)
+{
+	if (low_quality != low_quality_) {
+		low_quality_ = low_quality;
+		Classify(0, length_);
+	}
+}
+
+void PositionClasses::ClearEdited()
+{
+	std::fill(bits_[EDITED_INDEX].begin(), bits_[EDITED_INDEX].end(), 0);
+}
+
+void PositionClasses::Classify(size_t start, size_t end)
+{
+	const NucleotideSequence::base_type* bases = sequence_.cbegin();
+	const NucleotideSequence::quality_type* quality = sequence_.QualityBegin();
+	for (size_t i = start / WORD_BITS; i * WORD_BITS < end; ++i) {
+		size_t word_start = i * WORD_BITS;
+		size_t first = std::max(start, word_start);
+		size_t last = std::min(end, word_start + WORD_BITS);
+		uint64_t n = 0;
+		uint64_t redundant = 0;
+		uint64_t low_quality = 0;
+		for (size_t j = first; j < last; ++j) {
+			NucleotideSequence::base_type base = bases[j];
+			uint8_t flags = LookupTables::BaseFlags(base);
+			int q = quality[j];
+			size_t shift = j - word_start;
+			n |= uint64_t((base == 'N') | (base == 'n')) << shift;
+			redundant |= uint64_t((flags & (flags - 1)) != 0) << shift;
+			low_quality |= uint64_t((q >= MIN_QUALITY) & (q < low_quality_)) << shift;
+		}
+		uint64_t keep = ~RangeMask(first - word_start, last - word_start);
+		bits_[N_INDEX][i] = (bits_[N_INDEX][i] & keep) | n;
+		bits_[REDUNDANT_INDEX][i] = (bits_[REDUNDANT_INDEX][i] & keep) | redundant;
+		bits_[LOW_QUALITY_INDEX][i] = (bits_[LOW_QUALITY_INDEX][i] & keep) | low_quality;
+	}
+}
+
+uint64_t PositionClasses::Word(size_t i, unsigned int classes) const
+{
+	uint64_t word = 0;
+	for (size_t c = 0; c < CLASS_COUNT; ++c) {
+		if (classes & (1u << c))
+			word |= bits_[c][i];
+	}
+	return word;
+}
@@ -0,0 +1,298 @@
+// A set of primers and adapters compiled for searching reads.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include "exception.h"
+#include "primerset.h"
+
+static const char FILE_MAGIC[4] = { 'C', 'P', 'R', 'S' };
+// Guards against allocating for a corrupted count.
+static const uint32_t MAX_STRING_LENGTH = 1u << 20;
+
+static inline void ThrowCorruptCache()
+{
+	throw invalid_file_format("Primer set cache file is corrupted.");
+}
+
+template<typename T>
+static void WriteValue(std::ofstream& stream, T value)
+{
+	stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static T ReadValue(std::ifstream& stream)
+{
+	T value;
+	stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return value;
+}
+
+static void WriteString(std::ofstream& stream, const std::string& value)
+{
+	WriteValue(stream, uint32_t(value.length()));
+	stream.write(value.data(), value.length());
+}
+
+static std::string ReadString(std::ifstream& stream)
+{
+	uint32_t length = ReadValue<uint32_t>(stream);
+	if (length > MAX_STRING_LENGTH)
+		ThrowCorruptCache();
+	std::string value(length, '\0');
+	stream.read(&value[0], length);
+	return value;
+}
+
+PrimerSet::PrimerSet()
+	: max_mismatches_(0),
+	seed_length_(MAX_SEED_LENGTH)
+{
+}
+
+void PrimerSet::Add(const std::string& name, const std::string& bases, Orientation orientation)
+{
+	primers_.push_back(Primer{ name, bases, orientation });
+	seed_starts_.clear();
+	seeds_.clear();
+	scanned_.clear();
+}
+
+void PrimerSet::Compile(int max_mismatches)
+{
+	max_mismatches_ = std::max(max_mismatches, 0);
+	BuildPatterns();
+
+	// Any match of a primer of length n with m substitutions has an exact run of at least (n - m) / (m + 1) bases.
+	size_t shortest = MAX_SEED_LENGTH * (max_mismatches_ + 1) + max_mismatches_;
+	for (auto& primer : primers_)
+		shortest = std::min(shortest, primer.bases.length());
+	size_t guaranteed = shortest > size_t(max_mismatches_) ? (shortest - max_mismatches_) / (max_mismatches_ + 1) : 0;
+	seed_length_ = std::min(std::max(guaranteed, size_t(MIN_SEED_LENGTH)), size_t(MAX_SEED_LENGTH));
+
+	// Every seed of every pattern with each of the sequences its IUPAC codes stand for, as (code, seed). A pattern
+	// shorter than a seed, or with a seed standing for too many sequences, has none in the table, as a match might
+	// contain no other seed.
+	std::vector<std::pair<uint32_t, Seed>> entries;
+	std::vector<uint32_t> codes;
+	std::vector<uint32_t> expanded;
+	scanned_.clear();
+	for (size_t p = 0; p < patterns_.size(); ++p) {
+		const std::string& pattern = patterns_[p];
+		size_t pattern_entries = entries.size();
+		bool scan = pattern.length() < seed_length_;
+		for (size_t offset = 0; offset + seed_length_ <= pattern.length() && !scan; ++offset) {
+			codes.assign(1, 0);
+			for (size_t k = 0; k < seed_length_ && !scan; ++k) {
+				uint8_t flags = LookupTables::BaseFlags(pattern[offset + k]);
+				expanded.clear();
+				for (uint32_t code : codes) {
+					for (uint32_t base = 0; base < 4; ++base) {
+						if (flags & LookupTables::BaseFlags("ACGT"[base]))
+							expanded.push_back((code << 2) | base);
+					}
+				}
+				codes.swap(expanded);
+				scan = codes.size() > MAX_SEED_EXPANSIONS;
+			}
+			for (uint32_t code : codes)
+				entries.emplace_back(code, Seed{ uint32_t(p), uint32_t(offset) });
+		}
+		if (scan) {
+			entries.resize(pattern_entries);
+			scanned_.push_back(uint32_t(p));
+		}
+	}
+
+	// Counting sort of the seeds by code.
+	size_t code_count = size_t(1) << (seed_length_ * 2);
+	seed_starts_.assign(code_count + 1, 0);
+	for (auto& entry : entries)
+		++seed_starts_[entry.first + 1];
+	for (size_t c = 0; c < code_count; ++c)
+		seed_starts_[c + 1] += seed_starts_[c];
+	seeds_.resize(entries.size());
+	std::vector<uint32_t> next(seed_starts_.begin(), seed_starts_.end() - 1);
+	for (auto& entry : entries)
+		seeds_[next[entry.first]++] = entry.second;
+}
+
+void PrimerSet::Classify(const NucleotideSequence& read, std::vector<Hit>* hits) const
+{
+	hits->clear();
+	if (seed_starts_.empty())
+		return;
+	assert(seed_starts_.size() == (size_t(1) << (seed_length_ * 2)) + 1);
+	size_t length = read.Length();
+	const uint32_t mask = (uint32_t(1) << (seed_length_ * 2)) - 1;
+
+	// Candidate (start, pattern) pairs from each seed found in the read.
+	std::vector<std::pair<size_t, uint32_t>> candidates;
+	uint32_t code = 0;
+	size_t valid = 0;
+	for (size_t i = 0; i < length; ++i) {
+		int base = LookupTables::BaseCode(read[i]);
+		if (base < 0) {
+			valid = 0;
+			continue;
+		}
+		code = ((code << 2) | uint32_t(base)) & mask;
+		if (++valid < seed_length_)
+			continue;
+		size_t seed_start = i + 1 - seed_length_;
+		for (uint32_t s = seed_starts_[code]; s < seed_starts_[code + 1]; ++s) {
+			const Seed& seed = seeds_[s];
+			if (seed.offset <= seed_start && seed_start - seed.offset + patterns_[seed.pattern].length() <= length)
+				candidates.emplace_back(seed_start - seed.offset, seed.pattern);
+		}
+	}
+	for (uint32_t pattern : scanned_) {
+		size_t pattern_length = patterns_[pattern].length();
+		for (size_t start = 0; start + pattern_length <= length; ++start) {
+			if (CountMismatches(read, start, patterns_[pattern]) <= max_mismatches_)
+				candidates.emplace_back(start, pattern);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	for (auto& candidate : candidates) {
+		int mismatches = CountMismatches(read, candidate.first, patterns_[candidate.second]);
+		if (mismatches > max_mismatches_)
+			continue;
+		size_t primer = candidate.second / 2;
+		bool reverse = candidate.second % 2 != 0;
+		Orientation orientation = primers_[primer].orientation;
+		bool expected = orientation == Orientation::EITHER || (orientation == Orientation::REVERSE) == reverse;
+		hits->push_back(Hit{ primer, candidate.first, reverse, expected, mismatches });
+	}
+	std::stable_sort(hits->begin(), hits->end(), [](const Hit& x, const Hit& y) {
+		return x.start < y.start || (x.start == y.start && x.primer < y.primer);
+	});
+}
+
+void PrimerSet::Save(const char* path) const
+{
+	std::ofstream stream;
+	stream.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+	stream.open(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+	stream.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+	WriteValue(stream, FILE_VERSION);
+	WriteValue(stream, int32_t(max_mismatches_));
+	WriteValue(stream, uint32_t(seed_length_));
+	WriteValue(stream, uint32_t(primers_.size()));
+	for (auto& primer : primers_) {
+		WriteValue(stream, uint8_t(primer.orientation));
+		WriteString(stream, primer.name);
+		WriteString(stream, primer.bases);
+	}
+	WriteValue(stream, uint32_t(seed_starts_.size()));
+	stream.write(reinterpret_cast<const char*>(seed_starts_.data()), seed_starts_.size() * sizeof(uint32_t));
+	WriteValue(stream, uint32_t(seeds_.size()));
+	stream.write(reinterpret_cast<const char*>(seeds_.data()), seeds_.size() * sizeof(Seed));
+	WriteValue(stream, uint32_t(scanned_.size()));
+	stream.write(reinterpret_cast<const char*>(scanned_.data()), scanned_.size() * sizeof(uint32_t));
+	stream.close();
+}
+
+void PrimerSet::Load(const char* path)
+{
+	std::ifstream stream;
+	stream.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+	stream.open(path, std::ios_base::in | std::ios_base::binary);
+
+	try {
+		char magic[sizeof(FILE_MAGIC)];
+		stream.read(magic, sizeof(magic));
+		if (memcmp(magic, FILE_MAGIC, sizeof(magic)) || ReadValue<uint32_t>(stream) != FILE_VERSION)
+			throw invalid_file_format("Not a primer set cache file.");
+		int32_t max_mismatches = ReadValue<int32_t>(stream);
+		uint32_t seed_length = ReadValue<uint32_t>(stream);
+		uint32_t primer_count = ReadValue<uint32_t>(stream);
+		if (max_mismatches < 0 || seed_length < MIN_SEED_LENGTH || seed_length > MAX_SEED_LENGTH || primer_count > MAX_STRING_LENGTH)
+			ThrowCorruptCache();
+		std::vector<Primer> primers(primer_count);
+		for (auto& primer : primers) {
+			uint8_t orientation = ReadValue<uint8_t>(stream);
+			if (orientation > uint8_t(Orientation::EITHER))
+				ThrowCorruptCache();
+			primer.orientation = Orientation(orientation);
+			primer.name = ReadString(stream);
+			primer.bases = ReadString(stream);
+		}
+
+		// The table must be one compiled for these primers: every seed has to lie within its pattern.
+		uint32_t start_count = ReadValue<uint32_t>(stream);
+		if (start_count != (uint32_t(1) << (seed_length * 2)) + 1)
+			ThrowCorruptCache();
+		std::vector<uint32_t> seed_starts(start_count);
+		stream.read(reinterpret_cast<char*>(seed_starts.data()), seed_starts.size() * sizeof(uint32_t));
+		uint32_t seed_count = ReadValue<uint32_t>(stream);
+		if (seed_starts.front() != 0 || seed_starts.back() != seed_count || !std::is_sorted(seed_starts.cbegin(), seed_starts.cend()))
+			ThrowCorruptCache();
+		std::vector<Seed> seeds(seed_count);
+		stream.read(reinterpret_cast<char*>(seeds.data()), seeds.size() * sizeof(Seed));
+		for (auto& seed : seeds) {
+			if (seed.pattern >= primer_count * 2 || seed.offset + seed_length > primers[seed.pattern / 2].bases.length())
+				ThrowCorruptCache();
+		}
+		uint32_t scanned_count = ReadValue<uint32_t>(stream);
+		if (scanned_count > primer_count * 2)
+			ThrowCorruptCache();
+		std::vector<uint32_t> scanned(scanned_count);
+		stream.read(reinterpret_cast<char*>(scanned.data()), scanned.size() * sizeof(uint32_t));
+		for (uint32_t pattern : scanned) {
+			if (pattern >= primer_count * 2)
+				ThrowCorruptCache();
+		}
+
+		primers_ = std::move(primers);
+		max_mismatches_ = max_mismatches;
+		seed_length_ = seed_length;
+		seed_starts_ = std::move(seed_starts);
+		seeds_ = std::move(seeds);
+		scanned_ = std::move(scanned);
+		BuildPatterns();
+	}
+	catch (const std::ios_base::failure&) {
+		// Reading past the end.
+		ThrowCorruptCache();
+	}
+}
+
+void PrimerSet::BuildPatterns()
+{
+	patterns_.clear();
+	for (auto& primer : primers_) {
+		patterns_.push_back(primer.bases);
+		patterns_.push_back(LookupTables::ReverseComplement(primer.bases));
+	}
+}
+
+int PrimerSet::CountMismatches(const NucleotideSequence& read, size_t start, const std::string& pattern) const
+{
+	int mismatches = 0;
+	for (size_t k = 0; k < pattern.length() && mismatches <= max_mismatches_; ++k)
+		mismatches += !LookupTables::BaseMatch(read[start + k], pattern[k]);
+	return mismatches;
+}
@@ -0,0 +1,355 @@
+// Quality control reports for runs of sequencing traces.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <exception>
+#include <map>
+#include "qcreport.h"
+#include "ab1file.h"
+#include "qualitytrim.h"
+#include "scffile.h"
+#include "system.h"
+#include "threadpool.h"
+
+static const uint8_t FLAGS_AT = 0x5;
+static const uint8_t FLAGS_CG = 0xA;
+
+// The data numbers of the raw and analyzed traces in an ab1 file, in the order given by the FWO_ tag.
+static const int32_t AB1_TRACE_NUMBER = 9;
+static const char AB1_DEFAULT_ORDER[] = "GATC";
+
+enum class FileType
+{
+	UNKNOWN,
+	AB1,
+	SCF
+};
+
+static FileType GetFileType(const std::string& path)
+{
+	size_t dot = path.rfind('.');
+	if (dot == std::string::npos)
+		return FileType::UNKNOWN;
+	std::string extension;
+	for (size_t i = dot + 1; i < path.length(); ++i)
+		extension.push_back(LookupTables::Lowercase(path[i]));
+	if (extension == "ab1" || extension == "abi")
+		return FileType::AB1;
+	if (extension == "scf")
+		return FileType::SCF;
+	return FileType::UNKNOWN;
+}
+
+void QcReport::Measure(const NucleotideSequence& read, unsigned int trim_window, int trim_quality, ReadMetrics* metrics)
+{
+	size_t length = read.Length();
+	const NucleotideSequence::base_type* bases = read.cbegin();
+	const NucleotideSequence::quality_type* quality = read.QualityBegin();
+	const NucleotideSequence::peak_type* peaks = read.PeakBegin();
+	size_t peak_count = peaks ? std::min(length, size_t(read.PeakEnd() - peaks)) : 0;
+	const TraceChannel* heights[NucleotideSequence::TRACE_COUNT];
+	for (size_t i = 0; i < NucleotideSequence::TRACE_COUNT; ++i)
+		heights[i] = read.TraceHeights(i);
+	size_t trace_length = read.TraceLength();
+
+	size_t good = 0;
+	size_t gc = 0;
+	size_t at = 0;
+	double signal = 0.0;
+	size_t signal_count = 0;
+	for (size_t i = 0; i < length; ++i) {
+		good += quality[i] >= GOOD_QUALITY;
+		// Counted as by NucleotideSequence::ComputePercentGC().
+		uint8_t flags = LookupTables::BaseFlags(bases[i]);
+		gc += flags && (flags & ~FLAGS_CG) == 0;
+		at += flags && (flags & ~FLAGS_AT) == 0;
+		int channel = LookupTables::BaseCode(bases[i]);
+		if (i < peak_count && channel >= 0 && peaks[i] >= 0 && size_t(peaks[i]) < trace_length) {
+			signal += (*heights[channel])[peaks[i]];
+			++signal_count;
+		}
+	}
+
+	metrics->length = length;
+	metrics->good_quality_bases = good;
+	metrics->percent_gc = gc * 100.0f / (gc + at + !(gc + at));
+	metrics->signal = signal_count ? float(signal / double(signal_count)) : 0.0f;
+	metrics->spacing = NucleotideSequence::ComputeSpacing(peaks, peak_count);
+
+	QualityTrim trim(read);
+	size_t start = trim.WindowStart(trim_window, trim_quality);
+	size_t end = start != QualityTrim::NOT_FOUND ? trim.WindowEnd(start, trim_window, trim_quality) : QualityTrim::NOT_FOUND;
+	metrics->trimmed_length = end != QualityTrim::NOT_FOUND && end > start ? end - start : 0;
+}
+
+bool QcReport::Load(const char* path, NucleotideSequence* read, ReadMetrics* metrics)
+{
+	metrics->path = path;
+	metrics->plate.clear();
+	metrics->well.clear();
+	metrics->capillary = 0;
+	metrics->error.clear();
+	try {
+		switch (GetFileType(path)) {
+		case FileType::AB1:
+			return LoadAb1(path, read, metrics);
+		case FileType::SCF:
+			return LoadScf(path, read, metrics);
+		default:
+			metrics->error = "not an ab1 or SCF file";
+			return false;
+		}
+	}
+	catch (const std::exception& e) {
+		metrics->error = e.what();
+		return false;
+	}
+}
+
+bool QcReport::LoadAb1(const char* path, NucleotideSequence* read, ReadMetrics* metrics)
+{
+	Ab1File file(path);
+	Ab1File::Iterator<char> seq_begin, seq_end;
+	Ab1File::Iterator<uint8_t> qual_begin, qual_end;
+	if (file.SearchTag("PBAS", 1, seq_begin, seq_end) != Ab1File::SearchResult::SUCCESS) {
+		metrics->error = "no base calls";
+		return false;
+	}
+	// Quality values are optional.
+	if (file.SearchTag("PCON", 1, qual_begin, qual_end) != Ab1File::SearchResult::SUCCESS)
+		qual_begin = qual_end;
+	*read = NucleotideSequence(seq_begin, seq_end, qual_begin, qual_end, path);
+
+	Ab1File::Iterator<int32_t> peak_begin, peak_end;
+	Ab1File::Iterator<int32_t> file_begin[NucleotideSequence::TRACE_COUNT], file_end[NucleotideSequence::TRACE_COUNT];
+	bool traces = file.SearchTag("PLOC", 1, peak_begin, peak_end) == Ab1File::SearchResult::SUCCESS;
+	for (int32_t i = 0; traces && i < int32_t(NucleotideSequence::TRACE_COUNT); ++i)
+		traces = file.SearchTag("DATA", AB1_TRACE_NUMBER + i, file_begin[i], file_end[i]) == Ab1File::SearchResult::SUCCESS;
+	if (traces) {
+		Ab1File::Iterator<char> order_begin, order_end;
+		std::string order = AB1_DEFAULT_ORDER;
+		if (file.SearchTag("FWO_", 1, order_begin, order_end) == Ab1File::SearchResult::SUCCESS && order_end - order_begin == 4) {
+			for (size_t i = 0; i < order.length(); ++i)
+				order[i] = LookupTables::Uppercase(order_begin[i]);
+		}
+		// Put the channels in A, C, G, T order.
+		Ab1File::Iterator<int32_t> trace_begin[NucleotideSequence::TRACE_COUNT], trace_end[NucleotideSequence::TRACE_COUNT];
+		for (size_t i = 0; traces && i < NucleotideSequence::TRACE_COUNT; ++i) {
+			size_t j = order.find("ACGT"[i]);
+			traces = j != std::string::npos;
+			if (traces) {
+				trace_begin[i] = file_begin[j];
+				trace_end[i] = file_end[j];
+			}
+		}
+		if (traces)
+			read->LoadTraces(peak_begin, peak_end, trace_begin, trace_end);
+	}
+
+	file.SearchTag("CTNM", 1, metrics->plate);
+	file.SearchTag("TUBE", 1, metrics->well);
+	int32_t capillary;
+	if (file.SearchTag("LANE", 1, capillary) == Ab1File::SearchResult::SUCCESS)
+		metrics->capillary = capillary;
+	return true;
+}
+
+bool QcReport::LoadScf(const char* path, NucleotideSequence* read, ReadMetrics* metrics)
+{
+	ScfFile file(path);
+	ScfFile::Iterator<char> seq_begin, seq_end;
+	std::vector<uint8_t> quality;
+	if (!file.Sequence(seq_begin, seq_end) || !file.CalledBaseQualities(quality)) {
+		metrics->error = "no base calls";
+		return false;
+	}
+	*read = NucleotideSequence(seq_begin, seq_end, quality.cbegin(), quality.cend(), path);
+
+	ScfFile::Iterator<int32_t> peak_begin, peak_end;
+	ScfFile::TraceIterator<int32_t> trace_begin[NucleotideSequence::TRACE_COUNT], trace_end[NucleotideSequence::TRACE_COUNT];
+	bool traces = file.Peaks(peak_begin, peak_end);
+	for (size_t i = 0; traces && i < NucleotideSequence::TRACE_COUNT; ++i)
+		traces = file.Traces("ACGT"[i], trace_begin[i], trace_end[i]);
+	if (traces)
+		read->LoadTraces(peak_begin, peak_end, trace_begin, trace_end);
+	return true;
+}
+
+bool QcReport::FindTraceFiles(const char* directory, std::vector<std::string>* paths)
+{
+	std::vector<std::string> names;
+	if (!System::ListDirectory(directory, names))
+		return false;
+	std::sort(names.begin(), names.end());
+	for (auto& name : names) {
+		if (GetFileType(name) != FileType::UNKNOWN) {
+			paths->push_back(directory);
+			System::AppendName(paths->back(), name.c_str());
+		}
+	}
+	return true;
+}
+
+void QcReport::Run(const std::vector<std::string>& paths, unsigned int trim_window, int trim_quality, std::vector<ReadMetrics>* reads)
+{
+	reads->assign(paths.size(), ReadMetrics());
+	ThreadPool::Instance().ForEach(paths.size(), [&](size_t i) {
+		ReadMetrics& metrics = (*reads)[i];
+		NucleotideSequence read;
+		if (Load(paths[i].c_str(), &read, &metrics))
+			Measure(read, trim_window, trim_quality, &metrics);
+	});
+}
+
+void QcReport::Summarize(const std::vector<ReadMetrics>& reads, bool by_capillary, std::vector<Summary>* summaries)
+{
+	std::map<std::pair<std::string, int>, Summary> groups;
+	for (auto& read : reads) {
+		int capillary = by_capillary ? read.capillary : 0;
+		// New summaries are value-initialized, so all totals start at 0.
+		Summary& summary = groups[std::make_pair(read.plate, capillary)];
+		summary.plate = read.plate;
+		summary.capillary = capillary;
+		if (!read.error.empty()) {
+			++summary.failed;
+			continue;
+		}
+		++summary.reads;
+		summary.length += double(read.length);
+		summary.good_quality_bases += double(read.good_quality_bases);
+		summary.trimmed_length += double(read.trimmed_length);
+		summary.percent_gc += read.percent_gc;
+		summary.signal += read.signal;
+		summary.spacing += read.spacing;
+	}
+
+	summaries->clear();
+	for (auto& group : groups) {
+		Summary summary = group.second;
+		if (summary.reads) {
+			double count = double(summary.reads);
+			summary.length /= count;
+			summary.good_quality_bases /= count;
+			summary.trimmed_length /= count;
+			summary.percent_gc /= count;
+			summary.signal /= count;
+			summary.spacing /= count;
+		}
+		summaries->push_back(summary);
+	}
+}
+
+void QcReport::WriteCsvField(std::ostream& stream, const std::string& field)
+{
+	if (field.find_first_of(",\"\r\n") == std::string::npos) {
+		stream << field;
+		return;
+	}
+	stream << '"';
+	for (char c : field) {
+		if (c == '"')
+			stream << '"';
+		stream << c;
+	}
+	stream << '"';
+}
+
+void QcReport::WriteJsonString(std::ostream& stream, const std::string& value)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	stream << '"';
+	for (char c : value) {
+		if (c == '"' || c == '\\')
+			stream << '\\' << c;
+		else if ((unsigned char)c < 0x20)
+			stream << "\\u00" << hex_digits[(c >> 4) & 0xF] << hex_digits[c & 0xF];
+		else
+			stream << c;
+	}
+	stream << '"';
+}
+
+void QcReport::WriteCsv(std::ostream& stream, const std::vector<ReadMetrics>& reads)
+{
+	stream << "path,plate,well,capillary,length,good_quality_bases,trimmed_length,percent_gc,signal,spacing,error\n";
+	for (auto& read : reads) {
+		WriteCsvField(stream, read.path);
+		stream << ',';
+		WriteCsvField(stream, read.plate);
+		stream << ',';
+		WriteCsvField(stream, read.well);
+		stream << ',' << read.capillary;
+		if (read.error.empty()) {
+			stream << ',' << read.length << ',' << read.good_quality_bases << ',' << read.trimmed_length
+				<< ',' << read.percent_gc << ',' << read.signal << ',' << read.spacing << ',';
+		}
+		else {
+			stream << ",,,,,,,";
+			WriteCsvField(stream, read.error);
+		}
+		stream << '\n';
+	}
+}
+
+void QcReport::WriteCsv(std::ostream& stream, const std::vector<Summary>& summaries)
+{
+	stream << "plate,capillary,reads,failed,length,good_quality_bases,trimmed_length,percent_gc,signal,spacing\n";
+	for (auto& summary : summaries) {
+		WriteCsvField(stream, summary.plate);
+		stream << ',' << summary.capillary << ',' << summary.reads << ',' << summary.failed
+			<< ',' << summary.length << ',' << summary.good_quality_bases << ',' << summary.trimmed_length
+			<< ',' << summary.percent_gc << ',' << summary.signal << ',' << summary.spacing << '\n';
+	}
+}
+
+void QcReport::WriteJson(std::ostream& stream, const std::vector<ReadMetrics>& reads, const std::vector<Summary>& summaries)
+{
+	stream << "{\"reads\":[";
+	for (size_t i = 0; i < reads.size(); ++i) {
+		const ReadMetrics& read = reads[i];
+		stream << (i ? ",{" : "{") << "\"path\":";
+		WriteJsonString(stream, read.path);
+		stream << ",\"plate\":";
+		WriteJsonString(stream, read.plate);
+		stream << ",\"well\":";
+		WriteJsonString(stream, read.well);
+		stream << ",\"capillary\":" << read.capillary;
+		if (read.error.empty()) {
+			stream << ",\"length\":" << read.length << ",\"good_quality_bases\":" << read.good_quality_bases
+				<< ",\"trimmed_length\":" << read.trimmed_length << ",\"percent_gc\":" << read.percent_gc
+				<< ",\"signal\":" << read.signal << ",\"spacing\":" << read.spacing;
+		}
+		else {
+			stream << ",\"error\":";
+			WriteJsonString(stream, read.error);
+		}
+		stream << '}';
+	}
+	stream << "],\"summaries\":[";
+	for (size_t i = 0; i < summaries.size(); ++i) {
+		const Summary& summary = summaries[i];
+		stream << (i ? ",{" : "{") << "\"plate\":";
+		WriteJsonString(stream, summary.plate);
+		stream << ",\"capillary\":" << summary.capillary << ",\"reads\":" << summary.reads << ",\"failed\":" << summary.failed
+			<< ",\"length\":" << summary.length << ",\"good_quality_bases\":" << summary.good_quality_bases
+			<< ",\"trimmed_length\":" << summary.trimmed_length << ",\"percent_gc\":" << summary.percent_gc
+			<< ",\"signal\":" << summary.signal << ",\"spacing\":" << summary.spacing << '}';
+	}
+	stream << "]}\n";
+}
@@ -0,0 +1,153 @@
+// Quality trimming of sequencing reads.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <array>
+#include <cmath>
+#include "qualitytrim.h"
+
+using quality_type = NucleotideSequence::quality_type;
+
+// Quality values below this mean none was recorded.
+static const quality_type MIN_QUALITY = 2;
+
+// Probability of error for each phred quality value.
+static const std::array<double, 256>& ErrorProbabilities()
+{
+	static const std::array<double, 256> table = [] {
+		std::array<double, 256> p;
+		for (size_t q = 0; q < p.size(); ++q)
+			p[q] = std::pow(10.0, -double(q) / 10.0);
+		return p;
+	}();
+	return table;
+}
+
+// Find the segment [start, end) of [0, length) maximizing score(end) - score(start), where score(i) is a prefix sum.
+template<typename T, typename Score>
+static bool MaxSegment(size_t length, Score score, size_t* start, size_t* end)
+{
+	T best = 0;
+	T lowest = score(0);
+	size_t lowest_pos = 0;
+	for (size_t i = 1; i <= length; ++i) {
+		T s = score(i);
+		if (s - lowest > best) {
+			best = s - lowest;
+			*start = lowest_pos;
+			*end = i;
+		}
+		if (s < lowest) {
+			lowest = s;
+			lowest_pos = i;
+		}
+	}
+	return best > 0;
+}
+
+QualityTrim::QualityTrim(const NucleotideSequence& sequence)
+	: quality_sum_(sequence.Length() + 1),
+	missing_sum_(sequence.Length() + 1),
+	error_sum_(sequence.Length() + 1)
+{
+	const NucleotideSequence::base_type* bases = sequence.cbegin();
+	const quality_type* quality = sequence.QualityBegin();
+	const std::array<double, 256>& error = ErrorProbabilities();
+	size_t q = 0;
+	size_t missing = 0;
+	double e = 0.0;
+	// All three sums are built in one pass. The missing flag is computed without branches or table lookups.
+	for (size_t i = 0; i < sequence.Length(); ++i) {
+		q += quality[i];
+		missing += (quality[i] < MIN_QUALITY) & (bases[i] != 'N') & (bases[i] != 'n');
+		e += error[quality[i]];
+		quality_sum_[i + 1] = q;
+		missing_sum_[i + 1] = missing;
+		error_sum_[i + 1] = e;
+	}
+}
+
+size_t QualityTrim::WindowStart(unsigned int window, int quality) const
+{
+	size_t length = Length();
+	if (!length)
+		return NOT_FOUND;
+
+	size_t i = 0;
+	if (length > window) {
+		unsigned int min_q = window * quality;
+		for (; i < length - window; ++i) {
+			if (QualitySum(i, i + window) >= min_q)
+				break;
+			// Quality data may not be set at all
+			if (MissingCount(i + 1, i + 1 + window) > (window >> 1))
+				break;
+		}
+	}
+	for (; i < length; ++i) {
+		if (Missing(i) || (int)Quality(i) >= quality)
+			break;
+	}
+	if (i > 0 || Quality(0) >= MIN_QUALITY)
+		return i;
+	return NOT_FOUND;
+}
+
+size_t QualityTrim::WindowEnd(size_t start_pos, unsigned int window, int quality) const
+{
+	size_t length = Length();
+	if (!length || start_pos > length)
+		return NOT_FOUND;
+
+	size_t last = length - 1;
+	size_t i = last;
+	if (length - start_pos > window) {
+		unsigned int min_q = window * quality;
+		size_t end = length;
+		for (; end > start_pos + window; --end) {
+			if (QualitySum(end - window, end) >= min_q)
+				break;
+			// Quality data may not be set at all
+			if (MissingCount(end - 1 - window, end - 1) > (window >> 1))
+				break;
+		}
+		i = end - 1;
+	}
+	// Stops one before start_pos, wrapping if that is 0.
+	for (; i + 1 > start_pos; --i) {
+		if (Missing(i) || (int)Quality(i) >= quality)
+			break;
+	}
+	if (i < last || Quality(last) >= MIN_QUALITY)
+		return i + 1;
+	return NOT_FOUND;
+}
+
+bool QualityTrim::Mott(double limit, size_t* start, size_t* end) const
+{
+	return MaxSegment<double>(Length(), [this, limit](size_t i) {
+		return limit * double(i) - error_sum_[i];
+	}, start, end);
+}
+
+bool QualityTrim::MaxSubarray(int quality, size_t* start, size_t* end) const
+{
+	return MaxSegment<ptrdiff_t>(Length(), [this, quality](size_t i) {
+		return ptrdiff_t(quality_sum_[i]) - ptrdiff_t(i) * quality;
+	}, start, end);
+}
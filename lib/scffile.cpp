@@ -17,6 +17,7 @@
 // You should have received a copy of the GNU General Public License
 // along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
 
+#include <cstddef>
 #include <fstream>
 #include "exception.h"
 #include "scffile.h"
@@ -67,3 +68,45 @@ void ScfFile::ValidateHeader()
     if (header_->comments_offset > file_size_ || header_->comments_offset + header_->comments_size > file_size_)
         ThrowCorruptHeader();
 }
+
+bool ScfFile::Sequence(Iterator<char>& begin, Iterator<char>& end) const
+{
+    if (!header_->bases)
+        return false;
+    const char* bases = file_buffer_.get() + header_->bases_offset;
+    if (header_->version[0] < '3')
+        begin = Iterator<char>(bases + offsetof(ScfBase, base), 1, sizeof(ScfBase));
+    else
+        begin = Iterator<char>(bases + size_t(header_->bases) * 8, 1, 1);
+    end = begin + header_->bases;
+    return true;
+}
+
+bool ScfFile::CalledBaseQualities(std::vector<uint8_t>& qualities) const
+{
+    qualities.clear();
+    size_t count = header_->bases;
+    if (!count)
+        return false;
+    const char* bases = file_buffer_.get() + header_->bases_offset;
+    qualities.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        char base;
+        const uint8_t* probabilities;
+        size_t pitch;
+        if (header_->version[0] < '3') {
+            const char* entry = bases + i * sizeof(ScfBase);
+            base = entry[offsetof(ScfBase, base)];
+            probabilities = reinterpret_cast<const uint8_t*>(entry + offsetof(ScfBase, prob_A));
+            pitch = 1;
+        }
+        else {
+            base = bases[count * 8 + i];
+            probabilities = reinterpret_cast<const uint8_t*>(bases + count * 4 + i);
+            pitch = count;
+        }
+        uint32_t index = BaseIndex(base);
+        qualities.push_back(index == ~0u ? 0 : probabilities[index * pitch]);
+    }
+    return true;
+}
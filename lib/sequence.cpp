@@ -17,9 +17,12 @@
 // You should have received a copy of the GNU General Public License
 // along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <memory>
 #include "sequence.h"
 #include "align.h"
 #include "geneticcodes.h"
+#include "qualitytrim.h"
 
 NucleotideSequence::NucleotideSequence()
 {
@@ -28,6 +31,7 @@ NucleotideSequence::NucleotideSequence()
 NucleotideSequence::NucleotideSequence(const base_type* seq, size_t length, const char* name)
 	: sequence_(seq, (length == (size_t)-1) ? strlen(seq) : length)
 {
+	ConstructQuality();
 	SetName(name);
 }
 
@@ -94,11 +98,16 @@ float NucleotideSequence::ComputePercentGC() const
 
 float NucleotideSequence::ComputeSpacing() const
 {
-	if (Length() > 1 && traces_) {
+	return traces_ ? ComputeSpacing(PeakBegin(), std::min(Length(), size_t(PeakEnd() - PeakBegin()))) : 0.0f;
+}
+
+float NucleotideSequence::ComputeSpacing(const peak_type* peaks, size_t count)
+{
+	if (count > 1) {
 		peak_type total = 0;
-		for (auto peak = PeakBegin() + 1; peak != PeakEnd(); ++peak)
-			total += peak[0] - peak[-1];
-		return (float)total / float(Length() - 1);
+		for (size_t i = 1; i < count; ++i)
+			total += peaks[i] - peaks[i - 1];
+		return (float)total / float(count - 1);
 	}
 	return 0.0f;
 }
@@ -145,6 +154,14 @@ void NucleotideSequence::InitializeQuality(size_t start_pos, size_t length)
 	quality_.FillSubsequence(start_pos, length, 0);
 }
 
+void NucleotideSequence::ReplaceCalls(const base_type* bases, const quality_type* quality, const peak_type* peaks, size_t length)
+{
+	sequence_ = SeqContainer<base_type>(bases, length);
+	quality_ = SeqContainer<quality_type>(quality, length);
+	if (traces_)
+		traces_->peaks = SeqContainer<peak_type>(peaks, length);
+}
+
 void NucleotideSequence::ReverseComplement(peak_type trace_length_max)
 {
 	size_t back = Length() - 1;
@@ -209,14 +226,84 @@ size_t NucleotideSequence::SearchByAlignmentBack(size_t start_pos, const std::st
 	return (size_t)-1;
 }
 
-bool NucleotideSequence::MatchTranslation(size_t pos, const base_type* query, int genetic_code) const
+// Bit-parallel shift-and search of text[begin, end) for a pattern of the given length, with match masks of words
+// 64-bit words for each character. Returns the start of the first match, or of the last if last is set.
+static size_t ShiftAndSearch(const char* text, size_t begin, size_t end, const uint64_t* masks, size_t words, size_t length, bool last)
+{
+	auto state = std::make_unique<uint64_t[]>(words);
+	std::fill_n(state.get(), words, 0);
+	uint64_t final_bit = uint64_t(1) << ((length - 1) % 64);
+	size_t found = NucleotideSequence::NOT_FOUND;
+	for (size_t i = begin; i < end; ++i) {
+		const uint64_t* mask = masks + (unsigned char)text[i] * words;
+		uint64_t carry = 1;
+		for (size_t w = 0; w < words; ++w) {
+			uint64_t next_carry = state[w] >> 63;
+			state[w] = ((state[w] << 1) | carry) & mask[w];
+			carry = next_carry;
+		}
+		if (state[words - 1] & final_bit) {
+			found = i + 1 - length;
+			if (!last)
+				break;
+		}
+	}
+	return found;
+}
+
+size_t NucleotideSequence::FindInTranslation(size_t start_pos, bool backwards, const std::string& query, int genetic_code, bool both_strands) const
 {
-	for (; *query; ++query, pos += 3) {
-		GeneticCodes::Codon c = GeneticCodes::TranslateForward(cbegin(), pos, Length(), genetic_code);
-		if (!LookupTables::AminoAcidMatch(c.amino_acid, *query))
-			return false;
+	assert(start_pos <= Length());
+	size_t length = query.length();
+	if (!length)
+		return NOT_FOUND;
+
+	// Match masks for each translated character, for the query and for the reverse strand, on which the query is
+	// read towards the start of the sequence.
+	size_t words = (length + 63) / 64;
+	auto masks = std::make_unique<uint64_t[]>(256 * words * 2);
+	std::fill_n(masks.get(), 256 * words * 2, 0);
+	for (size_t c = 0; c < 256; ++c) {
+		uint64_t* mask = masks.get() + c * words;
+		uint64_t* reverse_mask = mask + 256 * words;
+		for (size_t j = 0; j < length; ++j) {
+			if (LookupTables::AminoAcidMatch(char(c), query[j]))
+				mask[j / 64] |= uint64_t(1) << (j % 64);
+			if (LookupTables::AminoAcidMatch(char(c), query[length - 1 - j]))
+				reverse_mask[j / 64] |= uint64_t(1) << (j % 64);
+		}
+	}
+
+	size_t found = NOT_FOUND;
+	std::string translation;
+	for (size_t strand = 0; strand < (both_strands ? 2u : 1u); ++strand) {
+		for (size_t frame = 0; frame < 3; ++frame) {
+			size_t count = Length() > frame ? (Length() - frame) / 3 : 0;
+			translation.resize(count);
+			GeneticCodes::Translate(cbegin(), frame, frame + count * 3, strand != 0, genetic_code, &translation[0]);
+			// Reverse strand codons are stored in sequence order so positions are the same for both strands.
+			if (strand)
+				std::reverse(translation.begin(), translation.end());
+			const uint64_t* frame_masks = masks.get() + strand * 256 * words;
+
+			size_t codon;
+			if (backwards) {
+				if (start_pos < frame)
+					continue;
+				size_t end = std::min(count, (start_pos - frame) / 3 + length);
+				codon = ShiftAndSearch(translation.c_str(), 0, end, frame_masks, words, length, true);
+				if (codon != NOT_FOUND && (found == NOT_FOUND || frame + codon * 3 > found))
+					found = frame + codon * 3;
+			}
+			else {
+				size_t begin = start_pos > frame ? (start_pos - frame + 2) / 3 : 0;
+				codon = ShiftAndSearch(translation.c_str(), begin, count, frame_masks, words, length, false);
+				if (codon != NOT_FOUND && (found == NOT_FOUND || frame + codon * 3 < found))
+					found = frame + codon * 3;
+			}
+		}
 	}
-	return true;
+	return found;
 }
 
 size_t NucleotideSequence::FindNextN(size_t start_pos) const
@@ -243,96 +330,10 @@ bool NucleotideSequence::IsRedundant(size_t pos) const
 
 size_t NucleotideSequence::ComputeQualityStart(unsigned int window, int quality) const
 {
-	if (Length() > window) {
-		unsigned int q = 0;
-		unsigned int min_q = window * quality;
-		size_t i = 0;
-		unsigned int zeros = 0;
-		for (; i < window; ++i) {
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				++zeros;
-			q += quality_[i];
-		}
-		for (; i < Length(); ++i) 		{
-			if (q >= min_q)
-				break;
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				++zeros;
-			if (quality_[i - window] < 2 && UppercaseBase(i - window) != 'N')
-				--zeros;
-			if (zeros > (window >> 1)) // Quality data may not be set at all
-				break;
-			q += quality_[i] - quality_[i - window];
-		}
-		i -= window;
-		for (; i < Length(); ++i) {
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				break;
-			if ((int)quality_[i] >= quality)
-				break;
-		}
-		if (i > 0 || quality_[0] > 1)
-			return i;
-	}
-	else if (Length()) {
-		size_t i;
-		for (i = 0; i < Length(); ++i) {
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				break;
-			if ((int)quality_[i] >= quality)
-				break;
-		}
-		if (i > 0 || quality_[0] > 1)
-			return i;
-	}
-	return -1;
-
+	return QualityTrim(*this).WindowStart(window, quality);
 }
 
 size_t NucleotideSequence::ComputeQualityEnd(size_t start_pos, unsigned int window, int quality) const
 {
-	size_t lLast = Length() - 1;
-	if (Length() - start_pos > window) {
-		unsigned int q = 0;
-		unsigned int min_q = window * quality;
-		size_t i = lLast;
-		unsigned int zeros = 0;
-		for (; i >= Length() - window; --i) 		{
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				++zeros;
-			q += quality_[i];
-		}
-		for (; i >= start_pos; --i) {
-			if (q >= min_q)
-				break;
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				++zeros;
-			if (quality_[i + window] < 2 && UppercaseBase(i + window) != 'N')
-				--zeros;
-			if (zeros > (window >> 1)) // Quality data may not be set at all
-				break;
-			q += quality_[i] - quality_[i + window];
-		}
-		i += window;
-		for (; i >= start_pos; --i) {
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				break;
-			if ((int)quality_[i] >= quality)
-				break;
-		}
-		if (i < lLast || quality_[lLast] > 1)
-			return i + 1;
-	}
-	else if (Length() > 0) {
-		size_t i;
-		for (i = Length() - 1; i >= start_pos; --i) {
-			if (quality_[i] < 2 && UppercaseBase(i) != 'N')
-				break;
-			if ((int)quality_[i] >= quality)
-				break;
-		}
-		if (i < lLast || quality_[lLast] > 1)
-			return i + 1;
-	}
-	return -1;
+	return QualityTrim(*this).WindowEnd(start_pos, window, quality);
 }
\ No newline at end of file
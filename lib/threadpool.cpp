@@ -0,0 +1,121 @@
+// Thread pool for running batches of independent jobs on all cores.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "threadpool.h"
+
+// Set on pool threads, and on a submitting thread while it runs jobs, so nested calls don't deadlock.
+static thread_local bool in_pool_job = false;
+
+ThreadPool::ThreadPool(unsigned int thread_count)
+	: batch_(nullptr), generation_(0), active_(0), stop_(false)
+{
+	for (unsigned int i = 1; i < thread_count; ++i)
+		workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (auto& worker : workers_)
+		worker.join();
+}
+
+ThreadPool& ThreadPool::Instance()
+{
+	static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+	return pool;
+}
+
+void ThreadPool::ForEach(size_t count, const std::function<void(size_t)>& function)
+{
+	if (workers_.empty() || count < 2 || in_pool_job) {
+		for (size_t i = 0; i < count; ++i)
+			function(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit_lock(submit_mutex_);
+
+	Batch batch;
+	batch.function = &function;
+	batch.count = count;
+	batch.next = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		batch_ = &batch;
+		++generation_;
+	}
+	wake_.notify_all();
+
+	in_pool_job = true;
+	RunBatch(batch);
+	in_pool_job = false;
+
+	{
+		// Workers which woke too late to take part find batch_ cleared and go back to sleep.
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_.wait(lock, [this] { return active_ == 0; });
+		batch_ = nullptr;
+	}
+
+	if (batch.error)
+		std::rethrow_exception(batch.error);
+}
+
+void ThreadPool::RunBatch(Batch& batch)
+{
+	for (size_t i = batch.next++; i < batch.count; i = batch.next++) {
+		try {
+			(*batch.function)(i);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(batch.error_mutex);
+			if (!batch.error)
+				batch.error = std::current_exception();
+			batch.next = batch.count;
+		}
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	in_pool_job = true;
+	size_t seen = 0;
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;) {
+		wake_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+		if (stop_)
+			return;
+		seen = generation_;
+		Batch* batch = batch_;
+		if (!batch)
+			continue;
+		++active_;
+		lock.unlock();
+		RunBatch(*batch);
+		lock.lock();
+		if (--active_ == 0)
+			done_.notify_all();
+	}
+}
@@ -0,0 +1,677 @@
+// Alignment with traceback.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// Alignments are computed in linear space with the divide-and-conquer method of Myers and Miller (1988), which
+// extends Hirschberg's algorithm to affine gaps. Semi-global and local alignments first locate the aligned ranges
+// with forward and reverse score-only passes, then align those ranges globally.
+// Banded alignments store the traceback for every cell in the band, which is linear in the sequence length for a
+// fixed band width.
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include "align.h"
+
+// Subproblems up to this many cells are solved with a full matrix.
+static const size_t BASE_CASE_CELLS = 1 << 12;
+
+// Low enough to never be chosen, but with room to add gap scores without overflow.
+static const int SCORE_MIN = INT_MIN / 4;
+
+// Column operations, before conversion to CIGAR.
+static const char OP_MATCH = 'M';
+static const char OP_INSERT = 'I';
+static const char OP_DELETE = 'D';
+
+// Traceback flags for full matrices. Each cell records where its H, E and F scores came from.
+static const uint8_t H_FROM_E = 1;
+static const uint8_t H_FROM_F = 2;
+static const uint8_t E_EXTEND = 4;
+static const uint8_t F_EXTEND = 8;
+// The cell starts a local or semi-global alignment.
+static const uint8_t H_START = 16;
+
+class PathAligner
+{
+public:
+	struct Cell
+	{
+		int score;
+		size_t row;
+		size_t column;
+	};
+
+	PathAligner(const int* const* rows, const int* weights, const uint8_t* query, size_t across, int gap_open, int gap_extend)
+		: rows_(rows), weights_(weights), query_(query), go_(gap_open), ge_(gap_extend),
+		cc_(std::make_unique<int[]>(across + 1)), dd_(std::make_unique<int[]>(across + 1)),
+		rr_(std::make_unique<int[]>(across + 1)), ss_(std::make_unique<int[]>(across + 1))
+	{
+	}
+
+	// Append the optimal global alignment of rows [a0, a1) and columns [b0, b1).
+	// tb and te are the gap open scores for a deletion touching the top-left and bottom-right corners respectively,
+	// which are zero when the deletion continues one from the enclosing problem.
+	void Diff(size_t a0, size_t a1, size_t b0, size_t b1, int tb, int te);
+
+	// Score-only pass from the top-left corner. In LOCAL mode the best cell anywhere is returned, otherwise the
+	// best cell in the last column, with rows allowed to start anywhere.
+	Cell BestEnd(size_t a0, size_t a1, size_t b0, size_t b1, Alignment::Mode mode) const;
+
+	// Append the optimal alignment of all rows and columns, computing only cells within band columns of the diagonal.
+	// The aligned range is returned in first and last. Returns true if the path touches the edge of the band.
+	bool Banded(size_t m, size_t n, Alignment::Mode mode, size_t band, Cell* first, Cell* last);
+
+	// Score-only pass anchored at the bottom-right corner. In LOCAL mode the best cell anywhere is returned, otherwise
+	// the best cell in the first column.
+	Cell BestStart(size_t a0, size_t a1, size_t b0, size_t b1, Alignment::Mode mode) const;
+
+	int Substitution(size_t i, size_t j) const {
+		return rows_[i][query_[j]] * weights_[i];
+	}
+
+	int GapOpen() const {
+		return go_;
+	}
+
+	int GapExtend() const {
+		return ge_;
+	}
+
+	const std::string& Operations() const {
+		return ops_;
+	}
+
+	void ClearOperations() {
+		ops_.clear();
+	}
+
+private:
+	void Forward(size_t a0, size_t a1, size_t b0, size_t b1, int tb);
+
+	void Reverse(size_t a0, size_t a1, size_t b0, size_t b1, int te);
+
+	void BaseCase(size_t a0, size_t a1, size_t b0, size_t b1, int tb, int te);
+
+	const int* const* rows_;
+	const int* weights_;
+	const uint8_t* query_;
+	int go_;
+	int ge_;
+	// Last row scores and deletion scores of the forward and reverse passes.
+	std::unique_ptr<int[]> cc_, dd_, rr_, ss_;
+	std::string ops_;
+};
+
+void PathAligner::Forward(size_t a0, size_t a1, size_t b0, size_t b1, int tb)
+{
+	size_t n = b1 - b0;
+	int* cc = cc_.get();
+	int* dd = dd_.get();
+	cc[0] = 0;
+	for (size_t j = 1; j <= n; ++j) {
+		cc[j] = go_ + int(j) * ge_;
+		dd[j] = cc[j] + go_;
+	}
+	int t = tb;
+	for (size_t i = a0; i < a1; ++i) {
+		int s = cc[0];
+		t += ge_;
+		int c = t;
+		cc[0] = c;
+		dd[0] = c;
+		int e = c + go_;
+		for (size_t j = 1; j <= n; ++j) {
+			e = std::max(e, c + go_) + ge_;
+			dd[j] = std::max(dd[j], cc[j] + go_) + ge_;
+			c = std::max(std::max(dd[j], e), s + Substitution(i, b0 + j - 1));
+			s = cc[j];
+			cc[j] = c;
+		}
+	}
+}
+
+void PathAligner::Reverse(size_t a0, size_t a1, size_t b0, size_t b1, int te)
+{
+	size_t n = b1 - b0;
+	int* rr = rr_.get();
+	int* ss = ss_.get();
+	rr[n] = 0;
+	for (ptrdiff_t j = n - 1; j >= 0; --j) {
+		rr[j] = go_ + int(n - j) * ge_;
+		ss[j] = rr[j] + go_;
+	}
+	int t = te;
+	for (size_t i = a1; i-- > a0;) {
+		int s = rr[n];
+		t += ge_;
+		int c = t;
+		rr[n] = c;
+		ss[n] = c;
+		int e = c + go_;
+		for (ptrdiff_t j = n - 1; j >= 0; --j) {
+			e = std::max(e, c + go_) + ge_;
+			ss[j] = std::max(ss[j], rr[j] + go_) + ge_;
+			c = std::max(std::max(ss[j], e), s + Substitution(i, b0 + j));
+			s = rr[j];
+			rr[j] = c;
+		}
+	}
+}
+
+void PathAligner::Diff(size_t a0, size_t a1, size_t b0, size_t b1, int tb, int te)
+{
+	size_t m = a1 - a0;
+	size_t n = b1 - b0;
+	if (n == 0) {
+		ops_.append(m, OP_DELETE);
+		return;
+	}
+	if (m == 0) {
+		ops_.append(n, OP_INSERT);
+		return;
+	}
+	if (m == 1 || (m + 1) * (n + 1) <= BASE_CASE_CELLS) {
+		BaseCase(a0, a1, b0, b1, tb, te);
+		return;
+	}
+
+	size_t mid = m / 2;
+	Forward(a0, a0 + mid, b0, b1, tb);
+	Reverse(a0 + mid, a1, b0, b1, te);
+
+	// Find the column where the optimal path crosses the middle row, either in a match or insertion (type 1),
+	// or in a deletion spanning it (type 2), which must not be charged the gap open score twice.
+	size_t best_j = 0;
+	bool type_2 = false;
+	int best = SCORE_MIN;
+	for (size_t j = 0; j <= n; ++j) {
+		int score = cc_[j] + rr_[j];
+		if (score > best) {
+			best = score;
+			best_j = j;
+			type_2 = false;
+		}
+		score = dd_[j] + ss_[j] - go_;
+		if (score > best) {
+			best = score;
+			best_j = j;
+			type_2 = true;
+		}
+	}
+
+	if (!type_2) {
+		Diff(a0, a0 + mid, b0, b0 + best_j, tb, go_);
+		Diff(a0 + mid, a1, b0 + best_j, b1, go_, te);
+	}
+	else {
+		Diff(a0, a0 + mid - 1, b0, b0 + best_j, tb, 0);
+		ops_.append(2, OP_DELETE);
+		Diff(a0 + mid + 1, a1, b0 + best_j, b1, 0, te);
+	}
+}
+
+void PathAligner::BaseCase(size_t a0, size_t a1, size_t b0, size_t b1, int tb, int te)
+{
+	size_t m = a1 - a0;
+	size_t n = b1 - b0;
+	size_t width = n + 1;
+	auto from = std::make_unique<uint8_t[]>((m + 1) * width);
+	auto h = std::make_unique<int[]>(width);
+	auto f = std::make_unique<int[]>(width);
+
+	h[0] = 0;
+	for (size_t j = 1; j <= n; ++j) {
+		h[j] = go_ + int(j) * ge_;
+		f[j] = SCORE_MIN;
+		from[j] = H_FROM_E | E_EXTEND;
+	}
+	for (size_t i = 1; i <= m; ++i) {
+		int diagonal = h[0];
+		h[0] = tb + int(i) * ge_;
+		from[i * width] = H_FROM_F | F_EXTEND;
+		int e = SCORE_MIN;
+		for (size_t j = 1; j <= n; ++j) {
+			uint8_t flags = 0;
+			int open = h[j - 1] + go_;
+			if (e < open)
+				e = open;
+			else
+				flags |= E_EXTEND;
+			e += ge_;
+			open = h[j] + go_;
+			if (f[j] < open)
+				f[j] = open;
+			else
+				flags |= F_EXTEND;
+			f[j] += ge_;
+			int score = diagonal + Substitution(a0 + i - 1, b0 + j - 1);
+			if (score < e) {
+				score = e;
+				flags |= H_FROM_E;
+			}
+			if (score < f[j]) {
+				score = f[j];
+				flags = (flags & ~H_FROM_E) | H_FROM_F;
+			}
+			diagonal = h[j];
+			h[j] = score;
+			from[i * width + j] = flags;
+		}
+	}
+
+	// A deletion reaching the bottom-right corner is charged te instead of the gap open score.
+	enum { STATE_H, STATE_E, STATE_F } state = STATE_H;
+	if (f[n] - go_ + te > h[n])
+		state = STATE_F;
+
+	std::string ops;
+	size_t i = m;
+	size_t j = n;
+	while (i > 0 && j > 0) {
+		uint8_t flags = from[i * width + j];
+		if (state == STATE_H) {
+			if (flags & H_FROM_F) {
+				state = STATE_F;
+			}
+			else if (flags & H_FROM_E) {
+				state = STATE_E;
+			}
+			else {
+				ops.push_back(OP_MATCH);
+				--i;
+				--j;
+			}
+		}
+		else if (state == STATE_E) {
+			ops.push_back(OP_INSERT);
+			state = (flags & E_EXTEND) ? STATE_E : STATE_H;
+			--j;
+		}
+		else {
+			ops.push_back(OP_DELETE);
+			state = (flags & F_EXTEND) ? STATE_F : STATE_H;
+			--i;
+		}
+	}
+	ops.append(i, OP_DELETE);
+	ops.append(j, OP_INSERT);
+	ops_.append(ops.rbegin(), ops.rend());
+}
+
+bool PathAligner::Banded(size_t m, size_t n, Alignment::Mode mode, size_t band, Cell* first, Cell* last)
+{
+	bool local = mode == Alignment::Mode::LOCAL;
+	bool free_rows = mode != Alignment::Mode::GLOBAL;
+
+	// Row i covers the columns of the diagonal between rows i and i + 1, widened by band on each side.
+	// Both ends of the window are non-decreasing, and consecutive windows always overlap.
+	auto row_lo = std::make_unique<size_t[]>(m + 1);
+	auto row_hi = std::make_unique<size_t[]>(m + 1);
+	auto row_offset = std::make_unique<size_t[]>(m + 2);
+	row_offset[0] = 0;
+	for (size_t i = 0; i <= m; ++i) {
+		size_t lo = m ? i * n / m : 0;
+		size_t hi = m ? ((i + 1) * n + m - 1) / m : n;
+		row_lo[i] = lo > band ? lo - band : 0;
+		row_hi[i] = std::min(n, hi + band);
+		row_offset[i + 1] = row_offset[i] + row_hi[i] - row_lo[i] + 1;
+	}
+	auto from = std::make_unique<uint8_t[]>(row_offset[m + 1]);
+	auto h = std::make_unique<int[]>(n + 1);
+	auto f = std::make_unique<int[]>(n + 1);
+	std::fill_n(h.get(), n + 1, SCORE_MIN);
+	std::fill_n(f.get(), n + 1, SCORE_MIN);
+
+	h[0] = 0;
+	from[0] = H_START;
+	for (size_t j = 1; j <= row_hi[0]; ++j) {
+		h[j] = local ? 0 : go_ + int(j) * ge_;
+		from[j] = local ? H_START : H_FROM_E | E_EXTEND;
+	}
+	Cell best = { SCORE_MIN, 0, 0 };
+	if (local)
+		best = { 0, 0, 0 };
+	else if (row_hi[0] == n)
+		best = { h[n], 0, n };
+
+	for (size_t i = 1; i <= m; ++i) {
+		size_t lo = row_lo[i];
+		size_t hi = row_hi[i];
+		uint8_t* row_from = from.get() + row_offset[i] - lo;
+		int diagonal = lo ? h[lo - 1] : h[0];
+		// Cells of the previous row to the left of this window are outside the band from here on.
+		for (size_t j = row_lo[i - 1]; j < lo; ++j) {
+			h[j] = SCORE_MIN;
+			f[j] = SCORE_MIN;
+		}
+		int e = SCORE_MIN;
+		size_t j = lo;
+		if (lo == 0) {
+			h[0] = free_rows ? 0 : go_ + int(i) * ge_;
+			f[0] = h[0];
+			row_from[0] = free_rows ? H_START : H_FROM_F | F_EXTEND;
+			j = 1;
+		}
+		for (; j <= hi; ++j) {
+			uint8_t flags = 0;
+			int open = (j > lo ? h[j - 1] : SCORE_MIN) + go_;
+			if (e < open)
+				e = open;
+			else
+				flags |= E_EXTEND;
+			e += ge_;
+			open = h[j] + go_;
+			if (f[j] < open)
+				f[j] = open;
+			else
+				flags |= F_EXTEND;
+			f[j] += ge_;
+			int score = diagonal + Substitution(i - 1, j - 1);
+			if (score < e) {
+				score = e;
+				flags |= H_FROM_E;
+			}
+			if (score < f[j]) {
+				score = f[j];
+				flags = (flags & ~H_FROM_E) | H_FROM_F;
+			}
+			if (local && score <= 0) {
+				score = 0;
+				flags = H_START;
+			}
+			diagonal = h[j];
+			h[j] = score;
+			row_from[j] = flags;
+			if (local && score > best.score)
+				best = { score, i, j };
+		}
+		if (!local && hi == n && (mode == Alignment::Mode::SEMI_GLOBAL || i == m) && h[n] > best.score)
+			best = { h[n], i, n };
+	}
+
+	*last = best;
+
+	std::string ops;
+	enum { STATE_H, STATE_E, STATE_F } state = STATE_H;
+	size_t i = best.row;
+	size_t j = best.column;
+	bool edge = false;
+	for (;;) {
+		edge |= (j == row_lo[i] && j > 0) || (j == row_hi[i] && j < n);
+		if (i == 0 && j == 0)
+			break;
+		uint8_t flags = from[row_offset[i] + j - row_lo[i]];
+		if (state == STATE_H) {
+			if (flags & H_START)
+				break;
+			if (flags & H_FROM_F) {
+				state = STATE_F;
+			}
+			else if (flags & H_FROM_E) {
+				state = STATE_E;
+			}
+			else {
+				ops.push_back(OP_MATCH);
+				--i;
+				--j;
+			}
+		}
+		else if (state == STATE_E) {
+			ops.push_back(OP_INSERT);
+			state = (flags & E_EXTEND) ? STATE_E : STATE_H;
+			--j;
+		}
+		else {
+			ops.push_back(OP_DELETE);
+			state = (flags & F_EXTEND) ? STATE_F : STATE_H;
+			--i;
+		}
+	}
+	*first = { 0, i, j };
+	ops_.append(ops.rbegin(), ops.rend());
+	return edge;
+}
+
+PathAligner::Cell PathAligner::BestEnd(size_t a0, size_t a1, size_t b0, size_t b1, Alignment::Mode mode) const
+{
+	bool local = mode == Alignment::Mode::LOCAL;
+	size_t n = b1 - b0;
+	auto h = std::make_unique<int[]>(n + 1);
+	auto f = std::make_unique<int[]>(n + 1);
+	h[0] = 0;
+	for (size_t j = 1; j <= n; ++j) {
+		h[j] = local ? 0 : go_ + int(j) * ge_;
+		f[j] = SCORE_MIN;
+	}
+	Cell best = { local ? 0 : h[n], a0, b0 + (local ? 0 : n) };
+	for (size_t i = a0; i < a1; ++i) {
+		int diagonal = h[0];
+		int c = 0;
+		int e = SCORE_MIN;
+		for (size_t j = 1; j <= n; ++j) {
+			e = std::max(e, c + go_) + ge_;
+			f[j] = std::max(f[j], h[j] + go_) + ge_;
+			c = std::max(std::max(f[j], e), diagonal + Substitution(i, b0 + j - 1));
+			if (local) {
+				c = std::max(c, 0);
+				if (c > best.score)
+					best = { c, i + 1, b0 + j };
+			}
+			diagonal = h[j];
+			h[j] = c;
+		}
+		if (!local && h[n] > best.score)
+			best = { h[n], i + 1, b1 };
+	}
+	return best;
+}
+
+PathAligner::Cell PathAligner::BestStart(size_t a0, size_t a1, size_t b0, size_t b1, Alignment::Mode mode) const
+{
+	bool local = mode == Alignment::Mode::LOCAL;
+	size_t n = b1 - b0;
+	auto h = std::make_unique<int[]>(n + 1);
+	auto f = std::make_unique<int[]>(n + 1);
+	h[n] = 0;
+	for (ptrdiff_t j = n - 1; j >= 0; --j) {
+		h[j] = go_ + int(n - j) * ge_;
+		f[j] = SCORE_MIN;
+	}
+	Cell best = { local ? 0 : h[0], a1, local ? b1 : b0 };
+	int t = go_;
+	for (size_t i = a1; i-- > a0;) {
+		int diagonal = h[n];
+		t += ge_;
+		int c = t;
+		h[n] = c;
+		int e = SCORE_MIN;
+		for (ptrdiff_t j = n - 1; j >= 0; --j) {
+			e = std::max(e, c + go_) + ge_;
+			f[j] = std::max(f[j], h[j] + go_) + ge_;
+			c = std::max(std::max(f[j], e), diagonal + Substitution(i, b0 + j));
+			if (local && c > best.score)
+				best = { c, i, b0 + j };
+			diagonal = h[j];
+			h[j] = c;
+		}
+		if (!local && h[0] > best.score)
+			best = { h[0], i, b0 };
+	}
+	return best;
+}
+
+// Fill in the traceback from the aligner's column operations, which start at row a0 and column b0.
+static void BuildTraceback(const NucleotideSequence& sequence, size_t start, const char* query, const PathAligner& aligner, size_t a0, size_t a1, size_t b0, size_t b1, Alignment::Traceback* traceback)
+{
+	Alignment::Traceback& result = *traceback;
+	result.score = 0;
+	result.start = start + a0;
+	result.end = start + a1;
+	result.query_start = b0;
+	result.query_end = b1;
+	result.cigar.clear();
+	result.aligned_sequence.clear();
+	result.aligned_query.clear();
+	result.mismatches.clear();
+
+	size_t i = a0, j = b0;
+	char prev_op = 0;
+	char prev_cigar = 0;
+	size_t run = 0;
+	for (char op : aligner.Operations()) {
+		char cigar_op;
+		if (op == OP_MATCH) {
+			char base = sequence[start + i];
+			result.aligned_sequence.push_back(base);
+			result.aligned_query.push_back(query[j]);
+			result.score += aligner.Substitution(i, j);
+			if (LookupTables::Uppercase(base) == LookupTables::Uppercase(query[j])) {
+				cigar_op = '=';
+			}
+			else {
+				cigar_op = 'X';
+				result.mismatches.push_back(start + i);
+			}
+			++i;
+			++j;
+		}
+		else {
+			if (op != prev_op)
+				result.score += aligner.GapOpen();
+			result.score += aligner.GapExtend();
+			if (op == OP_INSERT) {
+				result.aligned_sequence.push_back('-');
+				result.aligned_query.push_back(query[j++]);
+			}
+			else {
+				result.aligned_sequence.push_back(sequence[start + i++]);
+				result.aligned_query.push_back('-');
+			}
+			cigar_op = op;
+		}
+		if (cigar_op != prev_cigar && run) {
+			result.cigar += std::to_string(run);
+			result.cigar.push_back(prev_cigar);
+			run = 0;
+		}
+		prev_cigar = cigar_op;
+		prev_op = op;
+		++run;
+	}
+	if (run) {
+		result.cigar += std::to_string(run);
+		result.cigar.push_back(prev_cigar);
+	}
+}
+
+void Alignment::GetSearchRows(const NucleotideSequence& sequence, size_t start, size_t end, bool quality_weighted, const int** rows, int* weights)
+{
+	for (size_t i = 0; i < end - start; ++i) {
+		char base = sequence[start + i];
+		rows[i] = GetSearchMatrix(base);
+		if (!quality_weighted)
+			weights[i] = 1;
+		else if (LookupTables::Uppercase(base) == 'N')
+			weights[i] = N_QUALITY;
+		else
+			weights[i] = sequence.QualityOrDefault(start + i);
+	}
+}
+
+bool Alignment::Align(const NucleotideSequence& sequence, size_t start, size_t end, const char* query, Mode mode, bool quality_weighted, Traceback* traceback)
+{
+	assert(start <= end && end <= sequence.Length());
+
+	InitializeMatrix();
+
+	size_t down = end - start;
+	size_t across = strlen(query);
+	if (!down && !across)
+		return false;
+
+	auto rows = std::make_unique<const int*[]>(down);
+	auto weights = std::make_unique<int[]>(down);
+	GetSearchRows(sequence, start, end, quality_weighted, rows.get(), weights.get());
+	auto query_index = std::make_unique<uint8_t[]>(across);
+	for (size_t j = 0; j < across; ++j)
+		query_index[j] = LookupTables::IupacIndex(query[j]);
+
+	int gap_weight = quality_weighted ? NucleotideSequence::DEFAULT_BASE_QUALITY : 1;
+	PathAligner aligner(rows.get(), weights.get(), query_index.get(), across, TRACEBACK_GAP_OPEN * gap_weight, TRACEBACK_GAP_EXTEND * gap_weight);
+
+	size_t a0 = 0, a1 = down, b0 = 0, b1 = across;
+	if (mode != Mode::GLOBAL) {
+		PathAligner::Cell last = aligner.BestEnd(0, down, 0, across, mode);
+		if (mode == Mode::LOCAL && last.score <= 0)
+			return false;
+		a1 = last.row;
+		b1 = last.column;
+		PathAligner::Cell first = aligner.BestStart(0, a1, 0, b1, mode);
+		a0 = first.row;
+		b0 = first.column;
+	}
+	aligner.Diff(a0, a1, b0, b1, aligner.GapOpen(), aligner.GapOpen());
+
+	BuildTraceback(sequence, start, query, aligner, a0, a1, b0, b1, traceback);
+	return true;
+}
+
+bool Alignment::AlignBanded(const NucleotideSequence& sequence, size_t start, size_t end, const char* query, Mode mode, size_t band, bool quality_weighted, Traceback* traceback)
+{
+	assert(start <= end && end <= sequence.Length());
+
+	InitializeMatrix();
+
+	size_t down = end - start;
+	size_t across = strlen(query);
+	if (!down && !across)
+		return false;
+
+	auto rows = std::make_unique<const int*[]>(down);
+	auto weights = std::make_unique<int[]>(down);
+	GetSearchRows(sequence, start, end, quality_weighted, rows.get(), weights.get());
+	auto query_index = std::make_unique<uint8_t[]>(across);
+	for (size_t j = 0; j < across; ++j)
+		query_index[j] = LookupTables::IupacIndex(query[j]);
+
+	int gap_weight = quality_weighted ? NucleotideSequence::DEFAULT_BASE_QUALITY : 1;
+	PathAligner aligner(rows.get(), weights.get(), query_index.get(), 0, TRACEBACK_GAP_OPEN * gap_weight, TRACEBACK_GAP_EXTEND * gap_weight);
+
+	band = std::max<size_t>(band, 1);
+	PathAligner::Cell first, last;
+	int previous_score = SCORE_MIN;
+	for (;;) {
+		aligner.ClearOperations();
+		bool edge = aligner.Banded(down, across, mode, band, &first, &last);
+		// Once the band spans the whole matrix the result is exact.
+		if (band >= std::max(down, across))
+			break;
+		// A local path which drifts out of the band is cut short rather than bent onto its edge,
+		// so it is only trusted once widening the band no longer improves it.
+		if (!edge && (mode != Mode::LOCAL || last.score == previous_score))
+			break;
+		previous_score = last.score;
+		band *= 2;
+	}
+	if (mode == Mode::LOCAL && last.score <= 0)
+		return false;
+
+	BuildTraceback(sequence, start, query, aligner, first.row, last.row, first.column, last.column, traceback);
+	return true;
+}
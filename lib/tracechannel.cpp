@@ -0,0 +1,80 @@
+// Chromas trace channel class.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "tracechannel.h"
+
+using sample_type = TraceChannel::sample_type;
+
+template<typename T>
+static void WidenFrom(const T* narrow, size_t count, sample_type base, sample_type* samples)
+{
+	for (size_t i = 0; i < count; ++i)
+		samples[i] = base + sample_type(narrow[i]);
+}
+
+template<typename T>
+static std::unique_ptr<T[]> Narrow(const std::vector<sample_type>& samples, sample_type base)
+{
+	auto narrow = std::make_unique<T[]>(samples.size());
+	for (size_t i = 0; i < samples.size(); ++i)
+		narrow[i] = T(samples[i] - base);
+	return narrow;
+}
+
+void TraceChannel::Assign(const std::vector<sample_type>& samples)
+{
+	length_ = samples.size();
+	base_ = 0;
+	narrow8_.reset();
+	narrow16_.reset();
+	wide_.reset();
+
+	sample_type low = 0;
+	sample_type high = 0;
+	if (!samples.empty()) {
+		auto range = std::minmax_element(samples.cbegin(), samples.cend());
+		low = *range.first;
+		high = *range.second;
+	}
+	int64_t spread = int64_t(high) - low;
+	if (spread <= UINT8_MAX) {
+		base_ = low;
+		narrow8_ = Narrow<uint8_t>(samples, base_);
+	}
+	else if (spread <= UINT16_MAX) {
+		base_ = low;
+		narrow16_ = Narrow<uint16_t>(samples, base_);
+	}
+	else {
+		wide_ = std::make_unique<sample_type[]>(length_);
+		std::copy(samples.cbegin(), samples.cend(), wide_.get());
+	}
+}
+
+void TraceChannel::Widen(size_t start, size_t end, sample_type* samples) const
+{
+	assert(start <= end && end <= length_);
+	if (narrow8_)
+		WidenFrom(narrow8_.get() + start, end - start, base_, samples);
+	else if (narrow16_)
+		WidenFrom(narrow16_.get() + start, end - start, base_, samples);
+	else
+		std::copy(wide_.get() + start, wide_.get() + end, samples);
+}
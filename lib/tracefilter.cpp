@@ -0,0 +1,228 @@
+// Signal processing of trace channels.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include "tracefilter.h"
+
+using trace_type = TraceFilter::trace_type;
+
+// Compute the extreme of each window of 2 * half + 1 samples whose centre is in [half, count - half), in constant
+// time per sample: the window spans at most two blocks of its own size, so it is the extreme of the suffix of one
+// block and the prefix of the next.
+template<typename Select>
+static void SlidingExtreme(const float* in, size_t count, size_t half, float* out, Select select)
+{
+	size_t window = half * 2 + 1;
+	std::vector<float> prefix(count);
+	std::vector<float> suffix(count);
+	for (size_t i = 0; i < count; ++i)
+		prefix[i] = i % window ? select(prefix[i - 1], in[i]) : in[i];
+	for (size_t i = count; i-- > 0;)
+		suffix[i] = (i + 1) % window && i + 1 < count ? select(suffix[i + 1], in[i]) : in[i];
+	for (size_t j = half; j + half < count; ++j)
+		out[j] = select(suffix[j - half], prefix[j + half]);
+}
+
+static float Minimum(float x, float y)
+{
+	return std::min(x, y);
+}
+
+static float Maximum(float x, float y)
+{
+	return std::max(x, y);
+}
+
+void TraceFilter::AddBaselineSubtraction(size_t window)
+{
+	Stage stage = {};
+	stage.type = StageType::BASELINE;
+	stage.reach = window / 2;
+	stages_.push_back(stage);
+}
+
+void TraceFilter::AddSmoothing(size_t half_width)
+{
+	Stage stage = {};
+	stage.type = StageType::SMOOTHING;
+	stage.reach = half_width;
+	// Quadratic Savitzky-Golay weights: (3(3m^2 + 3m - 1) - 15k^2) / ((2m + 1)(4m^2 + 4m - 3)).
+	double m = double(half_width);
+	double divisor = (2 * m + 1) * (4 * m * m + 4 * m - 3);
+	for (int k = -int(half_width); k <= int(half_width); ++k)
+		stage.coefficients.push_back(half_width ? float((3 * (3 * m * m + 3 * m - 1) - 15.0 * k * k) / divisor) : 1.0f);
+	stages_.push_back(stage);
+}
+
+void TraceFilter::AddMobilityShift(const float shifts[TRACE_COUNT])
+{
+	Stage stage = {};
+	stage.type = StageType::SHIFT;
+	float largest = 0.0f;
+	for (size_t c = 0; c < TRACE_COUNT; ++c) {
+		stage.shifts[c] = shifts[c];
+		largest = std::max(largest, std::fabs(shifts[c]));
+	}
+	stage.reach = size_t(std::ceil(largest)) + 1;
+	stages_.push_back(stage);
+}
+
+void TraceFilter::AddNormalization(size_t window, trace_type height)
+{
+	Stage stage = {};
+	stage.type = StageType::NORMALIZATION;
+	stage.reach = window / 2;
+	stage.height = float(height);
+	stages_.push_back(stage);
+}
+
+size_t TraceFilter::Reach() const
+{
+	size_t reach = 0;
+	for (auto& stage : stages_)
+		reach += stage.reach;
+	return reach;
+}
+
+void TraceFilter::Apply(const std::vector<trace_type> input[TRACE_COUNT], std::vector<trace_type> output[TRACE_COUNT]) const
+{
+	size_t length = 0;
+	for (size_t c = 0; c < TRACE_COUNT; ++c)
+		length = std::max(length, input[c].size());
+	for (size_t c = 0; c < TRACE_COUNT; ++c)
+		output[c].resize(length);
+	if (!length)
+		return;
+
+	// Each block is loaded with the samples either side which the stages need, and each stage leaves a narrower
+	// range valid for the next.
+	size_t reach = Reach();
+	std::vector<float> in[TRACE_COUNT];
+	std::vector<float> out[TRACE_COUNT];
+	for (size_t block_start = 0; block_start < length; block_start += BLOCK_SIZE) {
+		size_t block_end = std::min(block_start + BLOCK_SIZE, length);
+		size_t buffer_length = block_end - block_start + reach * 2;
+		// Sample i of the buffers is sample i + origin of the traces.
+		int64_t origin = int64_t(block_start) - int64_t(reach);
+		size_t first_sample = size_t(std::max<int64_t>(-origin, 0));
+		size_t last_sample = size_t(int64_t(length) - 1 - origin);
+		for (size_t c = 0; c < TRACE_COUNT; ++c) {
+			in[c].resize(buffer_length);
+			out[c].resize(buffer_length);
+			for (size_t i = 0; i < buffer_length; ++i) {
+				int64_t sample = std::min(std::max<int64_t>(origin + int64_t(i), 0), int64_t(length) - 1);
+				in[c][i] = size_t(sample) < input[c].size() ? float(input[c][size_t(sample)]) : 0.0f;
+			}
+		}
+
+		size_t start = 0;
+		size_t end = buffer_length;
+		for (auto& stage : stages_) {
+			start += stage.reach;
+			end -= stage.reach;
+			ApplyStage(stage, in, out, start, end);
+			// Keep repeating the end samples beyond the ends of the traces, as if each stage ran over the whole trace.
+			for (size_t c = 0; c < TRACE_COUNT; ++c) {
+				for (size_t i = start; i < std::min(end, first_sample); ++i)
+					out[c][i] = out[c][first_sample];
+				for (size_t i = std::max(start, last_sample + 1); i < end; ++i)
+					out[c][i] = out[c][last_sample];
+			}
+			std::swap(in, out);
+		}
+
+		for (size_t c = 0; c < TRACE_COUNT; ++c) {
+			for (size_t i = reach; i < buffer_length - reach; ++i)
+				output[c][origin + int64_t(i)] = trace_type(std::lround(in[c][i]));
+		}
+	}
+}
+
+void TraceFilter::Apply(const NucleotideSequence& read, std::vector<trace_type> output[TRACE_COUNT]) const
+{
+	std::vector<trace_type> input[TRACE_COUNT];
+	if (read.HasTraces()) {
+		for (size_t c = 0; c < TRACE_COUNT; ++c) {
+			input[c].resize(read.TraceLength());
+			read.TraceHeights(c)->Widen(0, read.TraceLength(), input[c].data());
+		}
+	}
+	Apply(input, output);
+}
+
+void TraceFilter::ApplyStage(const Stage& stage, const std::vector<float>* in, std::vector<float>* out, size_t start, size_t end)
+{
+	size_t reach = stage.reach;
+	size_t count = end - start + reach * 2;
+	std::vector<float> extreme(count);
+	switch (stage.type) {
+	case StageType::BASELINE:
+		for (size_t c = 0; c < TRACE_COUNT; ++c) {
+			SlidingExtreme(in[c].data() + start - reach, count, reach, extreme.data(), Minimum);
+			for (size_t i = start; i < end; ++i)
+				out[c][i] = in[c][i] - extreme[i - start + reach];
+		}
+		break;
+
+	case StageType::SMOOTHING:
+		// Each coefficient is applied across the whole range in turn, rather than summing the window of each sample.
+		for (size_t c = 0; c < TRACE_COUNT; ++c) {
+			std::fill(out[c].begin() + start, out[c].begin() + end, 0.0f);
+			for (size_t k = 0; k < stage.coefficients.size(); ++k) {
+				float weight = stage.coefficients[k];
+				const float* source = in[c].data() + start - reach + k;
+				float* target = out[c].data() + start;
+				for (size_t i = 0; i < end - start; ++i)
+					target[i] += weight * source[i];
+			}
+		}
+		break;
+
+	case StageType::SHIFT:
+		for (size_t c = 0; c < TRACE_COUNT; ++c) {
+			float shift = stage.shifts[c];
+			float whole = std::floor(shift);
+			float fraction = shift - whole;
+			// Sample i takes its value from i - shift, between samples i - whole - 1 and i - whole.
+			int64_t offset = int64_t(whole);
+			for (size_t i = start; i < end; ++i) {
+				size_t later = size_t(int64_t(i) - offset);
+				out[c][i] = in[c][later] * (1.0f - fraction) + in[c][later - 1] * fraction;
+			}
+		}
+		break;
+
+	case StageType::NORMALIZATION:
+		{
+			std::vector<float> highest(count);
+			for (size_t i = 0; i < count; ++i) {
+				size_t j = start - reach + i;
+				highest[i] = std::max(std::max(in[0][j], in[1][j]), std::max(in[2][j], in[3][j]));
+			}
+			SlidingExtreme(highest.data(), count, reach, extreme.data(), Maximum);
+			for (size_t c = 0; c < TRACE_COUNT; ++c) {
+				for (size_t i = start; i < end; ++i)
+					out[c][i] = in[c][i] * stage.height / std::max(extreme[i - start + reach], 1.0f);
+			}
+		}
+		break;
+	}
+}
@@ -0,0 +1,175 @@
+// Min/max pyramid of trace heights for drawing zoomed out traces.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cassert>
+#include "tracepyramid.h"
+
+using trace_type = TracePyramid::trace_type;
+
+// Halve a level, taking the extreme of each pair of blocks.
+static void DecimateMinimum(const trace_type* in, size_t count, trace_type* out)
+{
+	for (size_t i = 0; i < count; ++i)
+		out[i] = std::min(in[i * 2], in[i * 2 + 1]);
+}
+
+static void DecimateMaximum(const trace_type* in, size_t count, trace_type* out)
+{
+	for (size_t i = 0; i < count; ++i)
+		out[i] = std::max(in[i * 2], in[i * 2 + 1]);
+}
+
+TracePyramid::TracePyramid(const NucleotideSequence& sequence)
+	: sequence_(sequence)
+{
+	Refresh();
+}
+
+void TracePyramid::Envelope(size_t channel, size_t start, size_t end, size_t pixels, std::vector<Extent>* envelope)
+{
+	assert(channel < NucleotideSequence::TRACE_COUNT);
+	envelope->assign(pixels, Extent{ 0, 0 });
+	end = std::min(end, trace_length_);
+	if (!pixels || start >= end)
+		return;
+	Build();
+
+	// The largest level with blocks no wider than a column.
+	size_t width = (end - start) / pixels;
+	size_t k = 0;
+	while (k + 1 < LevelCount() && (size_t(2) << k) <= width)
+		++k;
+	// Blocks are indexed from origin, which is start at level 0 where the samples in range are widened.
+	std::vector<trace_type> samples;
+	const trace_type* minimum;
+	const trace_type* maximum;
+	size_t origin = 0;
+	if (k > 0) {
+		const Level& level = levels_[channel][k - 1];
+		minimum = level.minimum.data();
+		maximum = level.maximum.data();
+	}
+	else {
+		samples.resize(end - start);
+		sequence_.TraceHeights(channel)->Widen(start, end, samples.data());
+		minimum = samples.data();
+		maximum = minimum;
+		origin = start;
+	}
+
+	size_t first = start >> k;
+	for (size_t p = 0; p < pixels; ++p) {
+		size_t next = p + 1 < pixels ? (start + (end - start) * (p + 1) / pixels) >> k : ((end - 1) >> k) + 1;
+		// A column narrower than a sample repeats it.
+		size_t last = std::max(next, first + 1);
+		Extent extent = { minimum[first - origin], maximum[first - origin] };
+		for (size_t i = first + 1; i < last; ++i) {
+			extent.minimum = std::min(extent.minimum, minimum[i - origin]);
+			extent.maximum = std::max(extent.maximum, maximum[i - origin]);
+		}
+		(*envelope)[p] = extent;
+		first = next;
+	}
+}
+
+void TracePyramid::Invalidate(size_t start, size_t end)
+{
+	end = std::min(end, trace_length_);
+	if (!built_ || start >= end)
+		return;
+	if (invalid_start_ < invalid_end_) {
+		invalid_start_ = std::min(invalid_start_, start);
+		invalid_end_ = std::max(invalid_end_, end);
+	}
+	else {
+		invalid_start_ = start;
+		invalid_end_ = end;
+	}
+}
+
+void TracePyramid::Refresh()
+{
+	trace_length_ = sequence_.TraceLength();
+	built_ = false;
+	invalid_start_ = 0;
+	invalid_end_ = 0;
+	for (auto& levels : levels_)
+		levels.clear();
+}
+
+void TracePyramid::Build()
+{
+	if (!built_) {
+		for (size_t channel = 0; channel < NucleotideSequence::TRACE_COUNT; ++channel) {
+			size_t size = trace_length_;
+			for (size_t k = 1; size > 1; ++k) {
+				size = (size + 1) / 2;
+				levels_[channel].push_back(Level{ std::vector<trace_type>(size), std::vector<trace_type>(size) });
+				BuildBlocks(channel, k, 0, size);
+			}
+		}
+		built_ = true;
+	}
+	else if (invalid_start_ < invalid_end_) {
+		// Only the blocks over the invalidated samples are rebuilt, and they halve in number at each level.
+		for (size_t channel = 0; channel < NucleotideSequence::TRACE_COUNT; ++channel) {
+			for (size_t k = 1; k < LevelCount(); ++k) {
+				size_t last = std::min(((invalid_end_ - 1) >> k) + 1, levels_[channel][k - 1].minimum.size());
+				BuildBlocks(channel, k, invalid_start_ >> k, last);
+			}
+		}
+	}
+	invalid_start_ = 0;
+	invalid_end_ = 0;
+}
+
+void TracePyramid::BuildBlocks(size_t channel, size_t k, size_t first, size_t last)
+{
+	// The blocks of the level below, from first * 2. Level 0 is widened from the stored samples.
+	std::vector<trace_type> samples;
+	const trace_type* minimum;
+	const trace_type* maximum;
+	size_t size;
+	if (k > 1) {
+		const Level& lower = levels_[channel][k - 2];
+		size = lower.minimum.size();
+		minimum = lower.minimum.data() + first * 2;
+		maximum = lower.maximum.data() + first * 2;
+	}
+	else {
+		size = trace_length_;
+		samples.resize(std::min(last * 2, size) - first * 2);
+		sequence_.TraceHeights(channel)->Widen(first * 2, first * 2 + samples.size(), samples.data());
+		minimum = samples.data();
+		maximum = minimum;
+	}
+	Level& level = levels_[channel][k - 1];
+
+	size_t pairs_end = std::min(last, size / 2);
+	if (pairs_end > first) {
+		DecimateMinimum(minimum, pairs_end - first, level.minimum.data() + first);
+		DecimateMaximum(maximum, pairs_end - first, level.maximum.data() + first);
+	}
+	// An odd block at the end covers a single block of the level below.
+	if (last > pairs_end) {
+		level.minimum[last - 1] = minimum[size - 1 - first * 2];
+		level.maximum[last - 1] = maximum[size - 1 - first * 2];
+	}
+}
@@ -0,0 +1,89 @@
+// Cached translation of all six reading frames of a sequence.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "translationcache.h"
+#include "geneticcodes.h"
+
+TranslationCache::TranslationCache(const NucleotideSequence& sequence, size_t genetic_code)
+	: sequence_(sequence),
+	genetic_code_(genetic_code)
+{
+	Refresh();
+}
+
+void TranslationCache::SetGeneticCode(size_t genetic_code)
+{
+	if (genetic_code != genetic_code_) {
+		genetic_code_ = genetic_code;
+		Refresh();
+	}
+}
+
+void TranslationCache::Refresh()
+{
+	size_t length = sequence_.Length();
+	for (size_t i = 0; i < FRAME_COUNT * 2; ++i) {
+		size_t frame = i % FRAME_COUNT;
+		std::string& amino_acids = frames_[i];
+		amino_acids.resize(CodonCount(length, frame));
+		GeneticCodes::Translate(sequence_.cbegin(), frame, frame + amino_acids.length() * 3, i >= FRAME_COUNT, genetic_code_, &amino_acids[0]);
+		// The reverse strand is translated from the end, but stored from the start.
+		if (i >= FRAME_COUNT)
+			std::reverse(amino_acids.begin(), amino_acids.end());
+	}
+}
+
+void TranslationCache::Update(size_t pos, size_t old_length, size_t new_length)
+{
+	size_t length = sequence_.Length();
+	assert(pos + new_length <= length);
+	size_t old_end = pos + old_length;
+	// Codons after the edit move from old frame h to new frame (h + shift) % 3.
+	size_t shift = (new_length + FRAME_COUNT * 2 - old_length % FRAME_COUNT) % FRAME_COUNT;
+
+	std::string updated[FRAME_COUNT * 2];
+	for (size_t i = 0; i < FRAME_COUNT * 2; ++i) {
+		size_t frame = i % FRAME_COUNT;
+		bool reverse = i >= FRAME_COUNT;
+		size_t after_frame = (frame + FRAME_COUNT - shift) % FRAME_COUNT;
+		const std::string& before = frames_[i];
+		const std::string& after = frames_[reverse * FRAME_COUNT + after_frame];
+
+		// Codons which end before the edit are unchanged, and those which start after it are only moved.
+		size_t head = CodonCount(pos, frame);
+		size_t tail_first = old_end > after_frame ? (old_end - after_frame + 2) / 3 : 0;
+		size_t tail = after.length() > tail_first ? after.length() - tail_first : 0;
+		size_t count = CodonCount(length, frame);
+		assert(head + tail <= count);
+
+		std::string& amino_acids = updated[i];
+		amino_acids.resize(count);
+		before.copy(&amino_acids[0], head);
+		size_t middle_start = frame + head * 3;
+		size_t middle = count - head - tail;
+		GeneticCodes::Translate(sequence_.cbegin(), middle_start, middle_start + middle * 3, reverse, genetic_code_, &amino_acids[head]);
+		if (reverse)
+			std::reverse(amino_acids.begin() + head, amino_acids.begin() + head + middle);
+		if (tail)
+			after.copy(&amino_acids[head + middle], tail, tail_first);
+	}
+	for (size_t i = 0; i < FRAME_COUNT * 2; ++i)
+		frames_[i].swap(updated[i]);
+}
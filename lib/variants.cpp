@@ -0,0 +1,200 @@
+// Variant calling from trace reads aligned to a reference.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <memory>
+#include "variants.h"
+#include "align.h"
+#include "threadpool.h"
+
+bool VariantCaller::CallVariants(const NucleotideSequence& reference, const NucleotideSequence& read, int min_secondary_percent, int min_quality, std::vector<Call>* calls)
+{
+	calls->clear();
+	if (reference.Empty() || read.Empty())
+		return false;
+
+	std::string bases(read.cbegin(), read.cend());
+	Alignment::Traceback traceback;
+	if (!Alignment::Align(reference, 0, reference.Length(), bases.c_str(), Alignment::Mode::LOCAL, false, &traceback))
+		return false;
+
+	// Gather the aligned base pairs, skipping gap columns.
+	size_t column_count = traceback.aligned_sequence.length();
+	auto positions = std::make_unique<size_t[]>(column_count);
+	auto read_positions = std::make_unique<size_t[]>(column_count);
+	size_t count = 0;
+	size_t pos = traceback.start;
+	size_t read_pos = traceback.query_start;
+	for (size_t k = 0; k < column_count; ++k) {
+		bool has_base = traceback.aligned_sequence[k] != '-';
+		bool has_read_base = traceback.aligned_query[k] != '-';
+		if (has_base && has_read_base) {
+			positions[count] = pos;
+			read_positions[count] = read_pos;
+			++count;
+		}
+		pos += has_base;
+		read_pos += has_read_base;
+	}
+
+	auto percents = std::make_unique<int[]>(count);
+	ComputeSecondaryPercents(read, read_positions.get(), count, percents.get());
+
+	for (size_t k = 0; k < count; ++k) {
+		size_t i = read_positions[k];
+		int quality = read.QualityOrDefault(i);
+		if (quality < min_quality)
+			continue;
+		Call call;
+		call.position = positions[k];
+		call.read_position = i;
+		call.reference_base = reference[positions[k]];
+		call.read_base = read[i];
+		call.secondary_percent = percents[k];
+		call.quality = quality;
+		if (percents[k] >= min_secondary_percent) {
+			call.type = Type::HETEROZYGOTE;
+			call.call = HeterozygoteCall(read, i);
+		}
+		else if ((LookupTables::BaseFlags(call.reference_base) & LookupTables::BaseFlags(call.read_base)) == 0) {
+			call.type = Type::SNV;
+			call.call = call.read_base;
+		}
+		else {
+			continue;
+		}
+		calls->push_back(call);
+	}
+	return true;
+}
+
+void VariantCaller::CallVariants(const NucleotideSequence& reference, const NucleotideSequence* const* reads, size_t read_count, int min_secondary_percent, int min_quality, std::vector<Call>* calls)
+{
+	ThreadPool::Instance().ForEach(read_count, [&](size_t i) {
+		CallVariants(reference, *reads[i], min_secondary_percent, min_quality, &calls[i]);
+	});
+}
+
+bool VariantCaller::SecondaryPeaks(const NucleotideSequence& read, int recall_percent, std::vector<SecondaryPeak>* peaks)
+{
+	peaks->clear();
+	size_t trace_length = read.TraceLength();
+	if (!read.HasTraces() || !trace_length)
+		return false;
+
+	// Each channel is widened once and sampled at every peak, rather than indexed separately for each base.
+	const NucleotideSequence::peak_type* peak = read.PeakBegin();
+	size_t length = std::min(read.Length(), size_t(read.PeakEnd() - peak));
+	std::vector<NucleotideSequence::trace_type> samples(trace_length);
+	peaks->resize(length);
+	for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+		read.TraceHeights(c)->Widen(0, trace_length, samples.data());
+		for (size_t i = 0; i < length; ++i)
+			(*peaks)[i].heights[c] = WindowHeight(samples.data(), trace_length, peak[i]);
+	}
+
+	for (size_t i = 0; i < length; ++i) {
+		SecondaryPeak& entry = (*peaks)[i];
+		const NucleotideSequence::trace_type* height = entry.heights;
+		int channel = LookupTables::BaseCode(read[i]);
+		entry.called_channel = channel >= 0 ? size_t(channel) : size_t(std::max_element(height, height + NucleotideSequence::TRACE_COUNT) - height);
+		entry.secondary_channel = entry.called_channel ? 0 : 1;
+		for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+			if (c != entry.called_channel && height[c] > height[entry.secondary_channel])
+				entry.secondary_channel = c;
+		}
+		int64_t called = std::max<int64_t>(height[entry.called_channel], 1);
+		int64_t secondary = std::max<int64_t>(height[entry.secondary_channel], 0);
+		entry.secondary_percent = int(secondary * 100 / called);
+		entry.call = recall_percent > 0 && entry.secondary_percent >= recall_percent ? LookupTables::TwoBaseCode(int(entry.called_channel), int(entry.secondary_channel)) : read[i];
+	}
+	return true;
+}
+
+void VariantCaller::SecondaryPeaks(const NucleotideSequence* const* reads, size_t read_count, int recall_percent, std::vector<SecondaryPeak>* peaks)
+{
+	ThreadPool::Instance().ForEach(read_count, [&](size_t i) {
+		SecondaryPeaks(*reads[i], recall_percent, &peaks[i]);
+	});
+}
+
+void VariantCaller::ComputeSecondaryPercents(const NucleotideSequence& read, const size_t* read_positions, size_t count, int* percents)
+{
+	if (!read.HasTraces() || !read.TraceLength()) {
+		std::fill_n(percents, count, 0);
+		return;
+	}
+
+	// Channel heights are gathered into one array per channel so the ratios can be computed without branches.
+	auto heights = std::make_unique<NucleotideSequence::trace_type[]>(NucleotideSequence::TRACE_COUNT * count);
+	for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+		NucleotideSequence::trace_type* channel = heights.get() + c * count;
+		for (size_t k = 0; k < count; ++k)
+			channel[k] = PeakHeight(read, c, read_positions[k]);
+	}
+
+	const NucleotideSequence::trace_type* a = heights.get();
+	const NucleotideSequence::trace_type* c = a + count;
+	const NucleotideSequence::trace_type* g = c + count;
+	const NucleotideSequence::trace_type* t = g + count;
+	for (size_t k = 0; k < count; ++k) {
+		int64_t high1 = std::max(a[k], c[k]);
+		int64_t low1 = std::min(a[k], c[k]);
+		int64_t high2 = std::max(g[k], t[k]);
+		int64_t low2 = std::min(g[k], t[k]);
+		int64_t primary = std::max<int64_t>(std::max(high1, high2), 1);
+		int64_t secondary = std::max(std::min(high1, high2), std::max(low1, low2));
+		percents[k] = int(std::max<int64_t>(secondary, 0) * 100 / primary);
+	}
+}
+
+char VariantCaller::HeterozygoteCall(const NucleotideSequence& read, size_t read_position)
+{
+	NucleotideSequence::trace_type height[NucleotideSequence::TRACE_COUNT];
+	size_t order[NucleotideSequence::TRACE_COUNT];
+	for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+		height[c] = PeakHeight(read, c, read_position);
+		order[c] = c;
+	}
+	std::sort(order, order + NucleotideSequence::TRACE_COUNT, [&](size_t x, size_t y) { return height[x] > height[y]; });
+	return LookupTables::TwoBaseCode(int(order[0]), int(order[1]));
+}
+
+NucleotideSequence::trace_type VariantCaller::PeakHeight(const NucleotideSequence& read, size_t channel, size_t read_position)
+{
+	if (read_position >= size_t(read.PeakEnd() - read.PeakBegin()))
+		return 0;
+	// Only the samples around the peak are widened.
+	size_t trace_length = read.TraceLength();
+	NucleotideSequence::peak_type centre = std::min(std::max(read.PeakBegin()[read_position], 0), NucleotideSequence::peak_type(trace_length - 1));
+	NucleotideSequence::peak_type first = std::max(centre - PEAK_HALF_WIDTH, 0);
+	size_t end = std::min(size_t(centre + PEAK_HALF_WIDTH) + 1, trace_length);
+	NucleotideSequence::trace_type samples[PEAK_HALF_WIDTH * 2 + 1];
+	read.TraceHeights(channel)->Widen(first, end, samples);
+	return WindowHeight(samples, end - first, centre - first);
+}
+
+NucleotideSequence::trace_type VariantCaller::WindowHeight(const NucleotideSequence::trace_type* samples, size_t sample_count, NucleotideSequence::peak_type peak)
+{
+	NucleotideSequence::peak_type last_sample = NucleotideSequence::peak_type(sample_count - 1);
+	NucleotideSequence::peak_type centre = std::min(std::max(peak, 0), last_sample);
+	NucleotideSequence::peak_type first = std::max(centre - PEAK_HALF_WIDTH, 0);
+	NucleotideSequence::peak_type last = std::min(centre + PEAK_HALF_WIDTH, last_sample);
+	return *std::max_element(samples + first, samples + last + 1);
+}
@@ -0,0 +1,258 @@
+// Tests for alignment functions.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <random>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "align.h"
+
+static std::string RandomBases(std::mt19937& rng, size_t length)
+{
+    std::string s;
+    for (size_t i = 0; i < length; ++i)
+        s.push_back("ACGT"[rng() & 3]);
+    return s;
+}
+
+TEST_CASE("Batch search by alignment", "[align_batch]")
+{
+    std::mt19937 rng(26);
+    static const char* queries[] = { "CAGACAGCG", "GATTACAGATTACA", "TTGGCCAAN" };
+    const size_t query_count = 3;
+
+    std::vector<std::unique_ptr<NucleotideSequence>> reads;
+    for (size_t i = 0; i < 37; ++i) {
+        std::string s = RandomBases(rng, (i == 5) ? 3000 : 20 + rng() % 300);
+        // Plant a slightly mutated query in most reads.
+        std::string q = queries[i % query_count];
+        q[q.length() / 2] = 'A';
+        if (i % 4 && s.length() > q.length())
+            s.replace(rng() % (s.length() - q.length()), q.length(), q);
+        reads.push_back(std::make_unique<NucleotideSequence>(s.c_str()));
+    }
+    reads.push_back(std::make_unique<NucleotideSequence>(""));
+
+    std::vector<const NucleotideSequence*> pointers;
+    for (auto& read : reads)
+        pointers.push_back(read.get());
+
+    std::vector<Alignment::Result> results(reads.size() * query_count);
+    Alignment::BatchSearch(pointers.data(), pointers.size(), queries, query_count, 80, results.data());
+
+    for (size_t i = 0; i < reads.size(); ++i) {
+        for (size_t j = 0; j < query_count; ++j) {
+            size_t expected = reads[i]->SearchByAlignmentFwd(0, queries[j], 80);
+            REQUIRE(results[i * query_count + j].start == (ptrdiff_t)expected);
+        }
+    }
+}
+
+// Full-matrix Gotoh alignment score for unambiguous bases, using the scores of Alignment::Align.
+static int ReferenceScore(const std::string& a, const std::string& b, Alignment::Mode mode)
+{
+    const int match = 2, mismatch = -6, open = -8, extend = -2, low = -1000000;
+    bool local = mode == Alignment::Mode::LOCAL;
+    bool free_rows = mode != Alignment::Mode::GLOBAL;
+    size_t m = a.length(), n = b.length();
+    std::vector<std::vector<int>> h(m + 1, std::vector<int>(n + 1)), e = h, f = h;
+    int best = local ? 0 : low;
+    for (size_t i = 0; i <= m; ++i) {
+        for (size_t j = 0; j <= n; ++j) {
+            if (i == 0 && j == 0) {
+                h[i][j] = 0;
+                e[i][j] = f[i][j] = low;
+            }
+            else if (i == 0) {
+                h[i][j] = e[i][j] = local ? 0 : open + extend * (int)j;
+                f[i][j] = low;
+            }
+            else if (j == 0) {
+                h[i][j] = f[i][j] = free_rows ? 0 : open + extend * (int)i;
+                e[i][j] = low;
+            }
+            else {
+                e[i][j] = std::max(e[i][j - 1], h[i][j - 1] + open) + extend;
+                f[i][j] = std::max(f[i - 1][j], h[i - 1][j] + open) + extend;
+                h[i][j] = std::max(h[i - 1][j - 1] + (a[i - 1] == b[j - 1] ? match : mismatch), std::max(e[i][j], f[i][j]));
+                if (local)
+                    h[i][j] = std::max(h[i][j], 0);
+            }
+            if (local)
+                best = std::max(best, h[i][j]);
+        }
+        if (mode == Alignment::Mode::SEMI_GLOBAL)
+            best = std::max(best, h[i][n]);
+    }
+    return mode == Alignment::Mode::GLOBAL ? h[m][n] : best;
+}
+
+TEST_CASE("Alignment with traceback", "[align_traceback]")
+{
+    std::mt19937 rng(27);
+    const Alignment::Mode modes[] = { Alignment::Mode::GLOBAL, Alignment::Mode::SEMI_GLOBAL, Alignment::Mode::LOCAL };
+
+    for (size_t test = 0; test < 30; ++test) {
+        // Mutate a copy of the sequence so that the alignments contain substitutions and gaps of various lengths.
+        std::string s = RandomBases(rng, 1 + rng() % (test < 10 ? 40 : 400));
+        std::string q = s.substr(rng() % (s.length() / 3 + 1));
+        for (size_t k = rng() % 8; k > 0 && q.length() > 4; --k) {
+            size_t pos = rng() % (q.length() - 3);
+            switch (rng() % 3) {
+            case 0: q[pos] = "ACGT"[rng() & 3]; break;
+            case 1: q.erase(pos, 1 + rng() % 3); break;
+            default: q.insert(pos, RandomBases(rng, 1 + rng() % 4)); break;
+            }
+        }
+        NucleotideSequence sequence(s.c_str());
+
+        for (auto mode : modes) {
+            Alignment::Traceback tb;
+            REQUIRE(Alignment::Align(sequence, 0, s.length(), q.c_str(), mode, false, &tb));
+            REQUIRE(tb.score == ReferenceScore(s, q, mode));
+            REQUIRE(tb.aligned_sequence.length() == tb.aligned_query.length());
+
+            // The aligned columns must reproduce the aligned ranges, and the CIGAR must describe the columns.
+            std::string seq_bases, query_bases;
+            size_t mismatches = 0;
+            for (size_t c = 0; c < tb.aligned_sequence.length(); ++c) {
+                if (tb.aligned_sequence[c] != '-')
+                    seq_bases.push_back(tb.aligned_sequence[c]);
+                if (tb.aligned_query[c] != '-')
+                    query_bases.push_back(tb.aligned_query[c]);
+                mismatches += tb.aligned_sequence[c] != '-' && tb.aligned_query[c] != '-' && tb.aligned_sequence[c] != tb.aligned_query[c];
+            }
+            REQUIRE(seq_bases == s.substr(tb.start, tb.end - tb.start));
+            REQUIRE(query_bases == q.substr(tb.query_start, tb.query_end - tb.query_start));
+            REQUIRE(tb.mismatches.size() == mismatches);
+            size_t columns = 0;
+            for (size_t c = 0; c < tb.cigar.length(); ++c) {
+                size_t digits;
+                columns += std::stoul(tb.cigar.substr(c), &digits);
+                c += digits;
+            }
+            REQUIRE(columns == tb.aligned_sequence.length());
+            if (mode == Alignment::Mode::GLOBAL)
+                REQUIRE((tb.start == 0 && tb.end == s.length() && tb.query_start == 0 && tb.query_end == q.length()));
+            if (mode == Alignment::Mode::SEMI_GLOBAL)
+                REQUIRE((tb.query_start == 0 && tb.query_end == q.length()));
+        }
+    }
+
+    NucleotideSequence sequence("ACGATCAGACTGCGAAGATTCCATACAGCG");
+    Alignment::Traceback tb;
+    REQUIRE(Alignment::Align(sequence, 0, sequence.Length(), "CTGCGAGATTCCATA", Alignment::Mode::SEMI_GLOBAL, true, &tb));
+    REQUIRE(tb.start == 9);
+    REQUIRE(tb.end == 25);
+    REQUIRE(tb.cigar == "5=1D10=");
+}
+
+TEST_CASE("Banded alignment", "[align_banded]")
+{
+    std::mt19937 rng(28);
+    const Alignment::Mode modes[] = { Alignment::Mode::GLOBAL, Alignment::Mode::SEMI_GLOBAL, Alignment::Mode::LOCAL };
+
+    for (size_t test = 0; test < 30; ++test) {
+        // A few percent divergence, as between a read and its reference.
+        std::string s = RandomBases(rng, 50 + rng() % 600);
+        std::string q = s;
+        for (size_t k = s.length() / 30; k > 0; --k) {
+            size_t pos = rng() % (q.length() - 3);
+            switch (rng() % 3) {
+            case 0: q[pos] = "ACGT"[rng() & 3]; break;
+            case 1: q.erase(pos, 1 + rng() % 3); break;
+            default: q.insert(pos, RandomBases(rng, 1 + rng() % 3)); break;
+            }
+        }
+        NucleotideSequence sequence(s.c_str());
+
+        for (auto mode : modes) {
+            Alignment::Traceback full, banded;
+            REQUIRE(Alignment::Align(sequence, 0, s.length(), q.c_str(), mode, false, &full));
+            REQUIRE(Alignment::AlignBanded(sequence, 0, s.length(), q.c_str(), mode, 2, false, &banded));
+            REQUIRE(banded.score == full.score);
+            REQUIRE(banded.aligned_sequence.length() == banded.aligned_query.length());
+        }
+    }
+}
+
+// Edit distance of the best match of query ending at each position of s.
+static std::vector<int> ReferenceEditDistances(const std::string& s, const std::string& query)
+{
+    std::vector<int> column(query.length() + 1);
+    for (size_t j = 0; j <= query.length(); ++j)
+        column[j] = int(j);
+    std::vector<int> ends;
+    for (char base : s) {
+        int diagonal = column[0];
+        for (size_t j = 1; j <= query.length(); ++j) {
+            int cell = std::min(diagonal + (LookupTables::BaseMatch(base, query[j - 1]) ? 0 : 1), std::min(column[j], column[j - 1]) + 1);
+            diagonal = column[j];
+            column[j] = cell;
+        }
+        ends.push_back(column[query.length()]);
+    }
+    return ends;
+}
+
+TEST_CASE("Edit distance search", "[edit_search]")
+{
+    std::mt19937 rng(29);
+
+    for (size_t test = 0; test < 40; ++test) {
+        std::string s = RandomBases(rng, 1 + rng() % 500);
+        if (test % 3 == 0)
+            s[rng() % s.length()] = 'N';
+        // Queries span one, two and three blocks, with degenerate bases as in primers.
+        std::string query = RandomBases(rng, 1 + rng() % 160);
+        for (size_t k = 0; k < query.length() / 10; ++k)
+            query[rng() % query.length()] = "RYSWKMBDHVN"[rng() % 11];
+        if (s.length() > query.length() && test % 2)
+            s.replace(rng() % (s.length() - query.length()), query.length(), query);
+        int max_errors = int(rng() % (query.length() / 4 + 2));
+        std::string reverse;
+        for (auto it = query.crbegin(); it != query.crend(); ++it)
+            reverse.push_back(LookupTables::Complement(*it));
+
+        NucleotideSequence sequence(s.c_str());
+        std::vector<Alignment::EditHit> hits;
+        Alignment::EditSearch(sequence, 0, s.length(), query.c_str(), max_errors, true, &hits);
+
+        std::vector<int> forward_errors = ReferenceEditDistances(s, query);
+        std::vector<int> reverse_errors = ReferenceEditDistances(s, reverse);
+        std::vector<Alignment::EditHit> expected;
+        for (size_t i = 0; i < s.length(); ++i) {
+            if (forward_errors[i] <= max_errors)
+                expected.push_back({ i + 1, forward_errors[i], false });
+            if (reverse_errors[i] <= max_errors)
+                expected.push_back({ i + 1, reverse_errors[i], true });
+        }
+        REQUIRE(hits.size() == expected.size());
+        for (size_t i = 0; i < hits.size(); ++i) {
+            REQUIRE(hits[i].end == expected[i].end);
+            REQUIRE(hits[i].errors == expected[i].errors);
+            REQUIRE(hits[i].reverse == expected[i].reverse);
+        }
+    }
+
+    NucleotideSequence sequence("TTTTGAATTCTTTT");
+    std::vector<Alignment::EditHit> hits;
+    Alignment::EditSearch(sequence, 0, sequence.Length(), "GARTTC", 0, false, &hits);
+    REQUIRE(hits.size() == 1);
+    REQUIRE(hits[0].end == 10);
+}
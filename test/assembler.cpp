@@ -0,0 +1,101 @@
+// Tests for assembling reads into contigs.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "assembler.h"
+
+static std::string RandomBases(std::mt19937& random, size_t length)
+{
+    std::string bases;
+    for (size_t i = 0; i < length; ++i)
+        bases.push_back("ACGT"[random() % 4]);
+    return bases;
+}
+
+TEST_CASE("Contig assembly", "[assembly]")
+{
+    std::mt19937 random(47);
+    std::string genome = RandomBases(random, 1200);
+    std::string unrelated = RandomBases(random, 300);
+
+    // Overlapping reads on both strands, one with a substitution and one with an inserted base.
+    std::string with_substitution = genome.substr(600, 400);
+    with_substitution[50] = with_substitution[50] == 'A' ? 'C' : 'A';
+    std::string with_insertion = genome.substr(550, 350);
+    with_insertion.insert(130, 1, 'G');
+    std::vector<std::string> bases = {
+        genome.substr(0, 400),
+        LookupTables::ReverseComplement(genome.substr(300, 400)),
+        with_substitution,
+        LookupTables::ReverseComplement(with_insertion),
+        genome.substr(850, 350),
+        unrelated,
+    };
+    std::vector<std::unique_ptr<NucleotideSequence>> reads;
+    std::vector<const NucleotideSequence*> pointers;
+    for (auto& read : bases) {
+        reads.push_back(std::make_unique<NucleotideSequence>(read.c_str()));
+        pointers.push_back(reads.back().get());
+    }
+
+    SECTION("Overlaps") {
+        std::vector<Assembler::Overlap> overlaps;
+        Assembler::FindOverlaps(pointers.data(), pointers.size(), 40, 90, &overlaps);
+        bool found = false;
+        for (auto& overlap : overlaps) {
+            REQUIRE(overlap.first < overlap.second);
+            REQUIRE(overlap.second != 5);
+            if (overlap.first == 0 && overlap.second == 1) {
+                found = true;
+                REQUIRE(overlap.reverse);
+                REQUIRE(overlap.offset == 300);
+                REQUIRE(overlap.length == 100);
+                REQUIRE(overlap.percent == 100);
+            }
+        }
+        REQUIRE(found);
+    }
+
+    SECTION("Contigs") {
+        std::vector<Assembler::Contig> contigs;
+        Assembler::Assemble(pointers.data(), pointers.size(), 40, 90, &contigs);
+        REQUIRE(contigs.size() == 2);
+        REQUIRE(contigs[0].consensus == genome);
+        REQUIRE(contigs[0].quality.size() == genome.length());
+        REQUIRE(contigs[0].reads.size() == 5);
+        const size_t starts[] = { 0, 300, 550, 600, 850 };
+        const size_t reads_at[] = { 0, 1, 3, 2, 4 };
+        for (size_t i = 0; i < 5; ++i) {
+            auto& placement = contigs[0].reads[i];
+            REQUIRE(placement.read == reads_at[i]);
+            REQUIRE(placement.reverse == (placement.read == 1 || placement.read == 3));
+            REQUIRE(placement.start == starts[i]);
+        }
+        // Three reads agree at the substitution against one.
+        REQUIRE(contigs[0].quality[650] < contigs[0].quality[640]);
+        REQUIRE(contigs[1].consensus == unrelated);
+        REQUIRE(contigs[1].reads.size() == 1);
+        REQUIRE(contigs[1].reads[0].read == 5);
+    }
+}
@@ -0,0 +1,110 @@
+// Tests for calling bases from traces.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "basecaller.h"
+
+static const size_t PEAK_SPACING = 12;
+
+// Make a read with a triangular peak for each base, none where the base is '-', and a secondary peak at 60% of the
+// primary in the second channel of a two base IUPAC code. The read's own calls are all N.
+static std::unique_ptr<NucleotideSequence> MakeRead(const std::string& bases)
+{
+    static const std::string trace_bases = "ACGT";
+    std::vector<NucleotideSequence::peak_type> peaks;
+    std::vector<NucleotideSequence::trace_type> channels[NucleotideSequence::TRACE_COUNT];
+    for (auto& channel : channels)
+        channel.assign(bases.length() * PEAK_SPACING, 0);
+    for (size_t i = 0; i < bases.length(); ++i) {
+        size_t peak = i * PEAK_SPACING + PEAK_SPACING / 2;
+        peaks.push_back(NucleotideSequence::peak_type(peak));
+        std::string called = bases[i] == 'R' ? "AG" : bases[i] == 'Y' ? "TC" : std::string(1, bases[i]);
+        for (size_t k = 0; k < called.length() && called[k] != '-'; ++k) {
+            int height = k ? 600 : 1000;
+            for (int d = -3; d <= 3; ++d)
+                channels[trace_bases.find(called[k])][peak + d] = height - height / 4 * std::abs(d);
+        }
+    }
+    const NucleotideSequence::trace_type* begins[NucleotideSequence::TRACE_COUNT];
+    const NucleotideSequence::trace_type* ends[NucleotideSequence::TRACE_COUNT];
+    for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+        begins[c] = channels[c].data();
+        ends[c] = channels[c].data() + channels[c].size();
+    }
+    auto read = std::make_unique<NucleotideSequence>(std::string(bases.length(), 'N').c_str());
+    read->LoadTraces(peaks.cbegin(), peaks.cend(), begins, ends);
+    return read;
+}
+
+TEST_CASE("Base calling", "[base_calling]")
+{
+    const std::string bases = "ACGTTGCAACRGTTACGGCA-TGCAYGTTCA";
+    auto read = MakeRead(bases);
+
+    std::vector<BaseCaller::Peak> peaks;
+    std::vector<NucleotideSequence::trace_type> samples(read->TraceLength());
+    read->TraceHeights(0)->Widen(0, samples.size(), samples.data());
+    BaseCaller::FindPeaks(samples.data(), samples.size(), 0, 100, &peaks);
+    REQUIRE(peaks.size() == 8);
+    REQUIRE(peaks[0].position == 6);
+    REQUIRE(peaks[0].height == 1000);
+    REQUIRE(BaseCaller::EstimateSpacing(peaks) > float(PEAK_SPACING));
+
+    BaseCaller::Calls calls;
+    REQUIRE(BaseCaller::Call(*read, 30, &calls));
+    std::string expected = bases;
+    expected[20] = 'N';
+    REQUIRE(calls.bases == expected);
+    REQUIRE(calls.peaks.size() == bases.length());
+    REQUIRE(calls.peaks[1] == NucleotideSequence::peak_type(PEAK_SPACING + PEAK_SPACING / 2));
+    REQUIRE(calls.spacing == float(PEAK_SPACING));
+    REQUIRE(calls.quality[0] == int(BaseCaller::MAX_QUALITY));
+    REQUIRE(calls.quality[10] == int(BaseCaller::MAX_QUALITY));
+    REQUIRE(calls.quality[20] == int(BaseCaller::MIN_QUALITY));
+    REQUIRE(calls.quality[19] < calls.quality[18]);
+
+    // Without mixed calls the higher channel is called, with the lower one lowering the quality.
+    REQUIRE(BaseCaller::Call(*read, 0, &calls));
+    REQUIRE(calls.bases[10] == 'A');
+    REQUIRE(calls.quality[10] < 10);
+
+    // Reads are recalled in parallel, keeping their traces.
+    std::vector<std::unique_ptr<NucleotideSequence>> reads;
+    reads.push_back(MakeRead(bases));
+    reads.push_back(MakeRead("ACGTACGTAC"));
+    reads.push_back(std::make_unique<NucleotideSequence>("ACGT"));
+    std::vector<NucleotideSequence*> pointers;
+    for (auto& r : reads)
+        pointers.push_back(r.get());
+    bool results[3];
+    BaseCaller::Recall(pointers.data(), pointers.size(), 30, results);
+    REQUIRE(results[0]);
+    REQUIRE(results[1]);
+    REQUIRE(!results[2]);
+    REQUIRE(std::string(reads[0]->cbegin(), reads[0]->cend()) == expected);
+    REQUIRE(std::string(reads[1]->cbegin(), reads[1]->cend()) == "ACGTACGTAC");
+    REQUIRE(reads[1]->HasTraces());
+    REQUIRE(reads[1]->QualityBegin()[0] == int(BaseCaller::MAX_QUALITY));
+    REQUIRE(reads[1]->ComputeSpacing() == float(PEAK_SPACING));
+}
@@ -0,0 +1,99 @@
+// Tests for the consensus of aligned reads.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "consensus.h"
+
+static std::unique_ptr<NucleotideSequence> MakeRead(const std::string& bases, NucleotideSequence::quality_type quality)
+{
+    std::vector<NucleotideSequence::quality_type> qualities(bases.length(), quality);
+    return std::make_unique<NucleotideSequence>(bases.cbegin(), bases.cend(), qualities.cbegin(), qualities.cend());
+}
+
+TEST_CASE("Consensus", "[consensus]")
+{
+    std::vector<std::unique_ptr<NucleotideSequence>> reads;
+    reads.push_back(MakeRead("ACGTACGTAC", 30));
+    reads.push_back(MakeRead("GTCGTAC", 20));
+    reads.push_back(MakeRead("TAGGT", 10));
+    std::vector<Consensus::AlignedRead> aligned = {
+        { reads[0].get(), 0, "ACGTACGTAC" },
+        { reads[1].get(), 2, "GT-CGTAC" },
+        { reads[2].get(), 3, "TAGGT" },
+    };
+    Consensus consensus(aligned);
+    REQUIRE(consensus.ColumnCount() == 10);
+    // The gap of read 1 is outvoted by reads 0 and 2, and the G of read 2 by reads 0 and 1.
+    REQUIRE(consensus.Call(4) == 'A');
+    REQUIRE(int(consensus.Quality(4)) == 20);
+    REQUIRE(consensus.Call(5) == 'C');
+    REQUIRE(int(consensus.Quality(5)) == 40);
+    REQUIRE(int(consensus.Quality(6)) == 60);
+    REQUIRE(int(consensus.Quality(0)) == 30);
+
+    NucleotideSequence sequence;
+    std::vector<uint64_t> discrepancies;
+    consensus.GetSequence(&sequence, &discrepancies);
+    REQUIRE(sequence.Length() == 10);
+    REQUIRE(std::string(sequence.cbegin(), sequence.cend()) == "ACGTACGTAC");
+    REQUIRE(int(sequence.QualityBegin()[5]) == 40);
+    REQUIRE(discrepancies == std::vector<uint64_t>{ 0x30 });
+
+    SECTION("Edited read") {
+        // Read 2 is edited to agree with the others, and its new qualities don't affect the votes taken away.
+        *reads[2] = std::move(*MakeRead("TACGT", 40));
+        consensus.UpdateRead(2, 3, "TACGT");
+        REQUIRE(consensus.Call(5) == 'C');
+        REQUIRE(!consensus.IsDiscrepant(5));
+        REQUIRE(int(consensus.Quality(5)) == 90);
+        REQUIRE(consensus.IsDiscrepant(4));
+        consensus.GetSequence(&sequence, &discrepancies);
+        REQUIRE(discrepancies == std::vector<uint64_t>{ 0x10 });
+    }
+
+    SECTION("Added read") {
+        // A read overlapping the end extends the alignment.
+        reads.push_back(MakeRead("ACTTGG", 40));
+        consensus.AddRead({ reads[3].get(), 8, "ACTTGG" });
+        REQUIRE(consensus.ColumnCount() == 14);
+        REQUIRE(int(consensus.Quality(8)) == 90);
+        REQUIRE(int(consensus.Quality(13)) == 40);
+        consensus.GetSequence(&sequence, &discrepancies);
+        REQUIRE(std::string(sequence.cbegin(), sequence.cend()) == "ACGTACGTACTTGG");
+    }
+
+    SECTION("Gap call") {
+        // Reads 0 and 2 lose the base in column 5, which drops it from the sequence, and read 0 no longer reaches the end.
+        *reads[0] = std::move(*MakeRead("ACGTAGT", 30));
+        consensus.UpdateRead(0, 0, "ACGTA-GT");
+        *reads[2] = std::move(*MakeRead("TAGT", 10));
+        consensus.UpdateRead(2, 3, "TA-GT");
+        REQUIRE(consensus.ColumnCount() == 10);
+        REQUIRE(consensus.Call(5) == '-');
+        REQUIRE(consensus.IsDiscrepant(5));
+        consensus.GetSequence(&sequence, &discrepancies);
+        REQUIRE(std::string(sequence.cbegin(), sequence.cend()) == "ACGTAGTAC");
+        REQUIRE(int(sequence.QualityBegin()[7]) == 20);
+    }
+}
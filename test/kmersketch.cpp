@@ -0,0 +1,112 @@
+// Tests for k-mer sketches.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "kmersketch.h"
+
+static std::string RandomBases(std::mt19937& random, size_t length)
+{
+    std::string bases;
+    for (size_t i = 0; i < length; ++i)
+        bases.push_back("ACGT"[random() % 4]);
+    return bases;
+}
+
+TEST_CASE("Canonical k-mers", "[kmer_sketch]")
+{
+    std::vector<uint64_t> kmers;
+    KmerSketch::CanonicalKmers(NucleotideSequence("AACNGT"), 2, &kmers);
+    // AA, AC, and GT as its reverse complement AC. The k-mers with N are skipped.
+    REQUIRE(kmers == std::vector<uint64_t>{ 0, 1, 1 });
+
+    std::mt19937 random(49);
+    std::string bases = RandomBases(random, 200);
+    std::string complement = LookupTables::ReverseComplement(bases);
+    for (size_t k : { size_t(5), size_t(21), size_t(KmerSketch::MAX_KMER_LENGTH) }) {
+        std::vector<uint64_t> forward;
+        std::vector<uint64_t> reverse;
+        KmerSketch::CanonicalKmers(NucleotideSequence(bases.c_str()), k, &forward);
+        KmerSketch::CanonicalKmers(NucleotideSequence(complement.c_str()), k, &reverse);
+        REQUIRE(forward.size() == bases.length() - k + 1);
+        std::sort(forward.begin(), forward.end());
+        std::sort(reverse.begin(), reverse.end());
+        REQUIRE(forward == reverse);
+    }
+}
+
+TEST_CASE("Sketch comparison", "[kmer_sketch]")
+{
+    std::mt19937 random(49);
+    std::vector<std::string> references;
+    for (size_t r = 0; r < 3; ++r)
+        references.push_back(RandomBases(random, 2000));
+
+    std::vector<KmerSketch> reference_sketches(references.size());
+    for (size_t r = 0; r < references.size(); ++r)
+        reference_sketches[r].BuildFracMinHash(NucleotideSequence(references[r].c_str()), 21, 4);
+
+    // Reads from each reference on either strand, with a substitution in each, and one read from none of them.
+    std::vector<std::string> reads;
+    std::vector<size_t> sources;
+    for (size_t i = 0; i < 30; ++i) {
+        size_t r = i % references.size();
+        std::string read = references[r].substr(random() % 1600, 400);
+        read[200] = read[200] == 'A' ? 'C' : 'A';
+        reads.push_back(i % 2 ? LookupTables::ReverseComplement(read) : read);
+        sources.push_back(r);
+    }
+    reads.push_back(RandomBases(random, 400));
+    sources.push_back(size_t(KmerSketch::NOT_FOUND));
+
+    SECTION("Assignment") {
+        std::vector<KmerSketch> read_sketches(reads.size());
+        for (size_t i = 0; i < reads.size(); ++i)
+            read_sketches[i].BuildFracMinHash(NucleotideSequence(reads[i].c_str()), 21, 4);
+        REQUIRE(reference_sketches[0].Jaccard(reference_sketches[0]) == 1.0);
+        REQUIRE(reference_sketches[0].Jaccard(reference_sketches[1]) == 0.0);
+        REQUIRE(read_sketches[0].Containment(reference_sketches[0]) > 0.8);
+
+        std::vector<size_t> assignments;
+        KmerSketch::Assign(read_sketches.data(), read_sketches.size(), reference_sketches.data(), reference_sketches.size(), 0.5, &assignments);
+        REQUIRE(assignments == sources);
+    }
+
+    SECTION("Clustering") {
+        // Whole references and reads of them cluster together as the same amplicon.
+        std::vector<KmerSketch> sketches(references.size() + 2);
+        for (size_t r = 0; r < references.size(); ++r)
+            sketches[r].BuildMinHash(NucleotideSequence(references[r].c_str()), 21, 500);
+        std::string copy = references[1];
+        copy[1000] = copy[1000] == 'A' ? 'C' : 'A';
+        sketches[3].BuildMinHash(NucleotideSequence(LookupTables::ReverseComplement(copy).c_str()), 21, 500);
+        sketches[4].BuildMinHash(NucleotideSequence(reads.back().c_str()), 21, 500);
+        REQUIRE(sketches[3].Hashes().size() == 500);
+        REQUIRE(sketches[1].Jaccard(sketches[3]) > 0.9);
+
+        std::vector<size_t> clusters;
+        KmerSketch::Cluster(sketches.data(), sketches.size(), 0.5, &clusters);
+        REQUIRE(clusters == std::vector<size_t>{ 0, 1, 2, 1, 3 });
+    }
+}
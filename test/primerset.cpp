@@ -0,0 +1,130 @@
+// Tests for searching reads for a set of primers.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "exception.h"
+#include "primerset.h"
+
+static const char CACHE_PATH[] = "primerset_test.bin";
+
+static void RequireHit(const PrimerSet::Hit& hit, size_t primer, size_t start, bool reverse, bool expected, int mismatches)
+{
+    REQUIRE(hit.primer == primer);
+    REQUIRE(hit.start == start);
+    REQUIRE(hit.reverse == reverse);
+    REQUIRE(hit.expected == expected);
+    REQUIRE(hit.mismatches == mismatches);
+}
+
+TEST_CASE("Primer set", "[primer_set]")
+{
+    PrimerSet primers;
+    primers.Add("forward", "ACGTTGCAAGGCTTAACGGA", PrimerSet::Orientation::FORWARD);
+    primers.Add("reverse", "GGATCCRYTTAGCANNAGTC", PrimerSet::Orientation::REVERSE);
+    primers.Add("adapter", "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA", PrimerSet::Orientation::EITHER);
+    primers.Compile(2);
+
+    // Random bases with the primers placed in them: the forward primer with a substitution, the reverse primer both
+    // ways round, and the adapter with an N at the end.
+    std::mt19937 random(50);
+    std::string bases;
+    for (size_t i = 0; i < 300; ++i)
+        bases.push_back("ACGT"[random() % 4]);
+    std::string forward = "ACGTTGCAAGGCTTTACGGA";
+    std::string reverse = "GGATCCATTTAGCATCAGTC";
+    std::string adapter = "AGATCGGAAGAGCACACGTCTGAACTCCAGTCN";
+    bases.replace(30, forward.length(), forward);
+    bases.replace(100, reverse.length(), LookupTables::ReverseComplement(reverse));
+    bases.replace(180, reverse.length(), reverse);
+    bases.replace(bases.length() - adapter.length(), adapter.length(), adapter);
+    NucleotideSequence read(bases.c_str());
+
+    std::vector<PrimerSet::Hit> hits;
+    primers.Classify(read, &hits);
+    REQUIRE(hits.size() == 4);
+    RequireHit(hits[0], 0, 30, false, true, 1);
+    RequireHit(hits[1], 1, 100, true, true, 0);
+    RequireHit(hits[2], 1, 180, false, false, 0);
+    RequireHit(hits[3], 2, bases.length() - adapter.length(), false, true, 1);
+
+    SECTION("Mismatch limit") {
+        primers.Compile(0);
+        primers.Classify(read, &hits);
+        REQUIRE(hits.size() == 2);
+        REQUIRE(hits[0].start == 100);
+        REQUIRE(hits[1].start == 180);
+    }
+
+    SECTION("Degenerate primer") {
+        // Every seed of this primer stands for too many sequences to index, so it is compared at every position. It is
+        // its own reverse complement, so it matches both ways round.
+        PrimerSet degenerate;
+        degenerate.Add("degenerate", "GGRYRYRYRYRYRYRYRYCC", PrimerSet::Orientation::EITHER);
+        degenerate.Compile(0);
+        std::string target = "GGACACACACACACACACCC";
+        std::string with_target = bases;
+        with_target.replace(220, target.length(), target);
+        degenerate.Classify(NucleotideSequence(with_target.c_str()), &hits);
+        REQUIRE(hits.size() == 2);
+        RequireHit(hits[0], 0, 220, false, true, 0);
+        RequireHit(hits[1], 0, 220, true, true, 0);
+
+        degenerate.Save(CACHE_PATH);
+        PrimerSet loaded;
+        loaded.Load(CACHE_PATH);
+        std::remove(CACHE_PATH);
+        loaded.Classify(NucleotideSequence(with_target.c_str()), &hits);
+        REQUIRE(hits.size() == 2);
+        REQUIRE(hits[1].start == 220);
+    }
+
+    SECTION("Cache file") {
+        primers.Save(CACHE_PATH);
+        PrimerSet loaded;
+        loaded.Load(CACHE_PATH);
+        REQUIRE(loaded.Count() == 3);
+        REQUIRE(loaded.GetPrimer(1).name == "reverse");
+        REQUIRE(loaded.GetPrimer(1).orientation == PrimerSet::Orientation::REVERSE);
+        std::vector<PrimerSet::Hit> loaded_hits;
+        loaded.Classify(read, &loaded_hits);
+        REQUIRE(loaded_hits.size() == hits.size());
+        for (size_t i = 0; i < hits.size(); ++i)
+            RequireHit(loaded_hits[i], hits[i].primer, hits[i].start, hits[i].reverse, hits[i].expected, hits[i].mismatches);
+
+        // A truncated file is rejected.
+        std::string data;
+        {
+            std::ifstream stream(CACHE_PATH, std::ios_base::binary);
+            data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        }
+        {
+            std::ofstream stream(CACHE_PATH, std::ios_base::binary | std::ios_base::trunc);
+            stream.write(data.data(), std::streamsize(data.length() / 2));
+        }
+        REQUIRE_THROWS_AS(loaded.Load(CACHE_PATH), invalid_file_format);
+        REQUIRE(loaded.Count() == 3);
+        std::remove(CACHE_PATH);
+    }
+}
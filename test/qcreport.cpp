@@ -0,0 +1,122 @@
+// Tests for run quality control reports.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "qcreport.h"
+
+static const char SCF_PATH[] = "qcreport_test.scf";
+static const size_t SCF_HEADER_SIZE = 128;
+
+static void PutBigEndian(std::string& data, uint32_t value, size_t size)
+{
+    for (size_t i = size; i-- > 0;)
+        data.push_back(char(value >> (i * 8)));
+}
+
+// Write a version 3 SCF file of bases ACGT with a peak of height 100, 200, 300, 400 for each in turn.
+static void WriteScf(const char* path)
+{
+    const char bases[] = "ACGT";
+    const uint8_t quality[] = { 30, 25, 20, 10 };
+    const size_t base_count = 4;
+    const size_t sample_count = 40;
+    size_t samples_offset = SCF_HEADER_SIZE;
+    size_t bases_offset = samples_offset + sample_count * 2 * 4;
+
+    std::string data(".scf");
+    for (uint32_t value : { sample_count, samples_offset, base_count, size_t(0), size_t(0), bases_offset, size_t(0), bases_offset + base_count * 12 })
+        PutBigEndian(data, uint32_t(value), 4);
+    data += "3.00";
+    PutBigEndian(data, 2, 4);
+    data.resize(SCF_HEADER_SIZE, 0);
+
+    // Each channel is stored separately as second differences.
+    for (size_t channel = 0; channel < 4; ++channel) {
+        int previous = 0, previous_delta = 0;
+        for (size_t i = 0; i < sample_count; ++i) {
+            int sample = i == channel * 10 + 5 ? int(channel + 1) * 100 : 0;
+            int delta = sample - previous;
+            PutBigEndian(data, uint32_t(delta - previous_delta), 2);
+            previous = sample;
+            previous_delta = delta;
+        }
+    }
+
+    for (size_t i = 0; i < base_count; ++i)
+        PutBigEndian(data, uint32_t(i * 10 + 5), 4);
+    for (size_t channel = 0; channel < 4; ++channel) {
+        for (size_t i = 0; i < base_count; ++i)
+            data.push_back(char(i == channel ? quality[i] : 0));
+    }
+    data.append(bases, base_count);
+    data.append(base_count * 3, 0);
+
+    std::ofstream stream(path, std::ios_base::binary);
+    stream.write(data.data(), data.size());
+}
+
+TEST_CASE("QC report", "[qc]")
+{
+    WriteScf(SCF_PATH);
+
+    std::vector<std::string> found;
+    REQUIRE(QcReport::FindTraceFiles(".", &found));
+    REQUIRE(std::any_of(found.cbegin(), found.cend(), [](const std::string& path) {
+        return path.find(SCF_PATH) != std::string::npos;
+    }));
+
+    std::vector<std::string> paths = { SCF_PATH, "qcreport_missing.ab1", "qcreport.txt" };
+    std::vector<QcReport::ReadMetrics> reads;
+    QcReport::Run(paths, 2, 20, &reads);
+    std::remove(SCF_PATH);
+    REQUIRE(reads.size() == 3);
+
+    const QcReport::ReadMetrics& read = reads[0];
+    INFO(read.error);
+    REQUIRE(read.error.empty());
+    REQUIRE(read.length == 4);
+    REQUIRE(read.good_quality_bases == 3);
+    REQUIRE(read.trimmed_length == 3);
+    REQUIRE(read.percent_gc == 50.0f);
+    REQUIRE(read.signal == 250.0f);
+    REQUIRE(read.spacing == 10.0f);
+    REQUIRE(!reads[1].error.empty());
+    REQUIRE(!reads[2].error.empty());
+
+    std::vector<QcReport::Summary> summaries;
+    QcReport::Summarize(reads, false, &summaries);
+    REQUIRE(summaries.size() == 1);
+    REQUIRE(summaries[0].reads == 1);
+    REQUIRE(summaries[0].failed == 2);
+    REQUIRE(summaries[0].signal == 250.0);
+
+    std::ostringstream csv;
+    QcReport::WriteCsv(csv, reads);
+    REQUIRE(csv.str().find("qcreport_test.scf,,,0,4,3,3,50,250,10,\n") != std::string::npos);
+    std::ostringstream json;
+    QcReport::WriteJson(json, reads, summaries);
+    REQUIRE(json.str().find("{\"reads\":[{\"path\":\"qcreport_test.scf\"") == 0);
+    REQUIRE(json.str().find("\"failed\":2") != std::string::npos);
+}
@@ -19,6 +19,12 @@
 
 #include "catch_amalgamated.hpp"
 #include "sequence.h"
+#include "geneticcodes.h"
+#include "qualitytrim.h"
+#include "positionclasses.h"
+#include "tracepyramid.h"
+#include "tracefilter.h"
+#include "peakindex.h"
 #include "ab1file.h"
 #include "scffile.h"
 
@@ -43,6 +49,15 @@ TEST_CASE("Sequence modification", "[modification]")
     REQUIRE(sequence.Length() == 4);
     REQUIRE(empty_sequence.Length() == 0);
 
+    SECTION("Spacing")
+    {
+        REQUIRE(sequence.ComputeSpacing() == Catch::Approx(37.0f / 3));
+        // Only the existing peaks are measured when a read has fewer peaks than bases.
+        NucleotideSequence few_peaks(seq + 0, seq + 4, qual + 0, qual + 4, nullptr);
+        few_peaks.LoadTraces(peaks + 0, peaks + 2, traces, traces);
+        REQUIRE(few_peaks.ComputeSpacing() == 12.0f);
+    }
+
     SECTION("Replace subsequence")
     {
         sequence.Replace(1, 1, 'R', 1, 11);
@@ -186,4 +201,399 @@ TEST_CASE("search by alignment", "[align_search]")
     NucleotideSequence sequence("ACGATCAGACTGCGAAGATTCCATACAGCG");
     REQUIRE(sequence.SearchByAlignmentFwd(0, "CAGACAGCG", 80) == 5);
     REQUIRE(sequence.SearchByAlignmentBack(sequence.Length() - 1, "CAGACAGCG", 80) == 21);
-}
\ No newline at end of file
+}
+// Position of the first (or last) match of a peptide, translating codon by codon.
+static size_t FindInTranslationSlow(const NucleotideSequence& sequence, size_t start_pos, bool backwards, const std::string& query, bool both_strands)
+{
+    size_t span = query.length() * 3;
+    if (span > sequence.Length())
+        return NucleotideSequence::NOT_FOUND;
+    size_t found = NucleotideSequence::NOT_FOUND;
+    for (size_t pos = 0; pos + span <= sequence.Length(); ++pos) {
+        if (backwards ? pos > start_pos : pos < start_pos)
+            continue;
+        bool forward = true;
+        bool reverse = both_strands;
+        for (size_t i = 0; i < query.length(); ++i) {
+            char aa = GeneticCodes::TranslateForward(sequence.cbegin(), pos + i * 3, sequence.Length(), 0).amino_acid;
+            forward &= LookupTables::AminoAcidMatch(aa, query[i]);
+            aa = GeneticCodes::TranslateReverseComplement(sequence.cbegin(), pos + span - (i + 1) * 3, sequence.Length(), 0).amino_acid;
+            reverse &= LookupTables::AminoAcidMatch(aa, query[i]);
+        }
+        if (forward || reverse) {
+            found = pos;
+            if (!backwards)
+                break;
+        }
+    }
+    return found;
+}
+
+TEST_CASE("find in translation", "[translation_search]")
+{
+    NucleotideSequence sequence("CCATGTGGAAAGATTAACC");
+    REQUIRE(sequence.FindInTranslation(0, false, "MWKD", 0) == 2);
+    REQUIRE(sequence.FindInTranslation(3, false, "MWKD", 0) == size_t(NucleotideSequence::NOT_FOUND));
+    REQUIRE(sequence.FindInTranslation(18, true, "KD", 0) == 8);
+    REQUIRE(sequence.FindInTranslation(0, false, "NLST", 0) == size_t(NucleotideSequence::NOT_FOUND));
+    REQUIRE(sequence.FindInTranslation(0, false, "NLST", 0, true) == 3);
+
+    std::string bases;
+    for (size_t i = 0; i < 3000; ++i)
+        bases.push_back("ACGTACGTACGTN"[(i * 7919 + i / 11) % 13]);
+    NucleotideSequence long_sequence(bases.c_str());
+    // The last query spans two words of match masks.
+    std::string peptide(70, ' ');
+    GeneticCodes::Translate(bases.c_str(), 1000, 1210, true, 0, &peptide[0]);
+    const std::string queries[] = { "TR", "X*", "BZX", peptide };
+    for (auto& query : queries) {
+        for (size_t start_pos = 0; start_pos < long_sequence.Length(); start_pos += 331) {
+            for (int flags = 0; flags < 4; ++flags) {
+                bool backwards = flags & 1;
+                bool both_strands = flags & 2;
+                REQUIRE(long_sequence.FindInTranslation(start_pos, backwards, query, 0, both_strands) == FindInTranslationSlow(long_sequence, start_pos, backwards, query, both_strands));
+            }
+        }
+    }
+}
+
+TEST_CASE("lookup tables", "[lookup]")
+{
+    // The tables are usable in constant expressions.
+    static_assert(LookupTables::Complement('A') == 'T' && LookupTables::Complement('r') == 'y', "complement");
+    static_assert(LookupTables::BaseFlags('N') == 15 && LookupTables::BaseFlags('U') == LookupTables::BaseFlags('T'), "base flags");
+    static_assert(LookupTables::BaseMatch('A', 'R') && !LookupTables::BaseMatch('R', 'A'), "base match");
+    static_assert(LookupTables::AminoAcidMatch('B', 'N') && !LookupTables::AminoAcidMatch('N', 'B'), "amino acid match");
+    static_assert(LookupTables::TwoBaseCode(0, 2) == 'R' && LookupTables::TwoBaseCode(3, 1) == 'Y', "two base code");
+    static_assert(LookupTables::BaseCode('g') == 2 && LookupTables::BaseCode('U') == 3 && LookupTables::BaseCode('R') < 0, "base code");
+
+    for (size_t i = 0; i < LookupTables::iupac_codes.size(); ++i) {
+        const char* code = LookupTables::iupac_codes[i];
+        REQUIRE(LookupTables::IupacIndex(code[0]) == i);
+        REQUIRE(LookupTables::IupacIndex(LookupTables::Lowercase(code[0])) == i);
+        // The complement of a code stands for the complements of its bases.
+        uint8_t complement_flags = 0;
+        for (const char* p = code + 2; *p; ++p)
+            complement_flags |= LookupTables::BaseFlags(LookupTables::Complement(*p));
+        REQUIRE(LookupTables::BaseFlagsComplement(code[0]) == complement_flags);
+    }
+    REQUIRE(LookupTables::IupacIndex('-') == size_t(LookupTables::IUPAC_UNDEFINED_INDEX));
+    REQUIRE(LookupTables::Uppercase('g') == 'G');
+    REQUIRE(LookupTables::Uppercase('\xe9') == '\xe9');
+    REQUIRE(LookupTables::CharIndex('z') == 25);
+    REQUIRE(LookupTables::AminoAcidMatch('X', 'W'));
+    REQUIRE(!LookupTables::AminoAcidMatch('W', 'X'));
+    REQUIRE(LookupTables::ReverseComplement("AACGTR") == "YACGTT");
+}
+
+TEST_CASE("quality trimming", "[quality]")
+{
+    std::string bases(50, 'A');
+    std::vector<uint8_t> quality(50, 40);
+    std::fill_n(quality.begin(), 10, 5);
+    std::fill_n(quality.end() - 10, 10, 5);
+    NucleotideSequence sequence(bases.begin(), bases.end(), quality.begin(), quality.end());
+
+    QualityTrim trim(sequence);
+    REQUIRE(trim.Length() == 50);
+    REQUIRE(trim.QualitySum(8, 13) == 130);
+    REQUIRE(trim.MissingCount(0, 50) == 0);
+    REQUIRE(trim.WindowStart(5, 20) == 10);
+    REQUIRE(trim.WindowEnd(10, 5, 20) == 40);
+    REQUIRE(sequence.ComputeQualityStart(5, 20) == 10);
+    REQUIRE(sequence.ComputeQualityEnd(10, 5, 20) == 40);
+
+    size_t start = 0, end = 0;
+    REQUIRE(trim.MaxSubarray(20, &start, &end));
+    REQUIRE(start == 10);
+    REQUIRE(end == 40);
+    REQUIRE(trim.Mott(0.05, &start, &end));
+    REQUIRE(start == 10);
+    REQUIRE(end == 40);
+    REQUIRE(!trim.MaxSubarray(41, &start, &end));
+
+    // Without quality values there is no good region.
+    NucleotideSequence unset(bases.c_str());
+    QualityTrim unset_trim(unset);
+    REQUIRE(unset_trim.MissingCount(0, 50) == 50);
+    REQUIRE(unset_trim.WindowStart(5, 20) == size_t(QualityTrim::NOT_FOUND));
+    REQUIRE(unset_trim.WindowEnd(0, 5, 20) == size_t(QualityTrim::NOT_FOUND));
+    REQUIRE(!unset_trim.Mott(0.05, &start, &end));
+}
+
+TEST_CASE("position classes", "[position_classes]")
+{
+    std::string bases;
+    for (size_t i = 0; i < 200; ++i)
+        bases += "ACGTNRYacgtn"[(i * 7) % 12];
+    std::vector<uint8_t> quality(bases.size(), 40);
+    quality[3] = 10;
+    quality[150] = 10;
+    quality[151] = 1;
+    NucleotideSequence sequence(bases.begin(), bases.end(), quality.begin(), quality.end());
+
+    PositionClasses classes(sequence, 20);
+    for (size_t i = 0; i <= sequence.Length(); ++i) {
+        REQUIRE(classes.FindNext(i, PositionClasses::N) == sequence.FindNextN(i));
+        REQUIRE(classes.FindNext(i, PositionClasses::REDUNDANT) == sequence.FindNextRedundant(i));
+    }
+    REQUIRE(classes.FindNext(0, PositionClasses::LOW_QUALITY) == 3);
+    REQUIRE(classes.FindNext(4, PositionClasses::LOW_QUALITY) == 150);
+    REQUIRE(classes.FindNext(151, PositionClasses::LOW_QUALITY) == size_t(PositionClasses::NOT_FOUND));
+    REQUIRE(classes.FindPrevious(200, PositionClasses::LOW_QUALITY) == 150);
+    REQUIRE(classes.FindPrevious(150, PositionClasses::LOW_QUALITY) == 3);
+    REQUIRE(classes.FindPrevious(3, PositionClasses::LOW_QUALITY) == size_t(PositionClasses::NOT_FOUND));
+    REQUIRE(classes.FindNext(0, PositionClasses::EDITED) == size_t(PositionClasses::NOT_FOUND));
+
+    // Insert an N, then delete a run spanning a word boundary.
+    sequence.Replace(100, 0, 'N', 40, 0);
+    classes.Update(100, 0, 1);
+    REQUIRE(classes.Is(100, PositionClasses::N | PositionClasses::EDITED));
+    REQUIRE(classes.FindNext(0, PositionClasses::EDITED) == 100);
+    REQUIRE(classes.FindNext(101, PositionClasses::EDITED) == size_t(PositionClasses::NOT_FOUND));
+    REQUIRE(classes.FindNext(4, PositionClasses::LOW_QUALITY) == 151);
+    sequence.DeleteSubsequence(60, 10);
+    classes.Update(60, 10, 0);
+    REQUIRE(classes.FindPrevious(sequence.Length(), PositionClasses::EDITED) == 90);
+    for (size_t i = 0; i <= sequence.Length(); ++i) {
+        REQUIRE(classes.FindNext(i, PositionClasses::N) == sequence.FindNextN(i));
+        REQUIRE(classes.FindNext(i, PositionClasses::REDUNDANT) == sequence.FindNextRedundant(i));
+    }
+
+    classes.SetLowQuality(5);
+    REQUIRE(classes.FindNext(0, PositionClasses::LOW_QUALITY) == size_t(PositionClasses::NOT_FOUND));
+    classes.ClearEdited();
+    REQUIRE(classes.FindNext(0, PositionClasses::EDITED) == size_t(PositionClasses::NOT_FOUND));
+}
+
+TEST_CASE("trace channel", "[trace_channel]")
+{
+    // Samples are stored in the narrowest width which holds their spread.
+    std::vector<int32_t> samples = { 1000, 1255, 1100 };
+    TraceChannel channel;
+    channel.Assign(samples.cbegin(), samples.cend(), 3);
+    REQUIRE(channel.Length() == 3);
+    REQUIRE(channel.SampleSize() == 1);
+    REQUIRE(channel[1] == 1255);
+    channel.Assign(samples.cbegin(), samples.cend(), 4);
+    REQUIRE(channel.SampleSize() == 2);
+    REQUIRE(channel[3] == 0);
+
+    samples = { -32768, 0, 32767 };
+    channel.Assign(samples);
+    REQUIRE(channel.SampleSize() == 2);
+    int32_t widened[3];
+    channel.Widen(0, 3, widened);
+    REQUIRE(std::equal(samples.cbegin(), samples.cend(), widened));
+
+    samples = { -40000, 40000 };
+    channel.Assign(samples);
+    REQUIRE(channel.SampleSize() == 4);
+    channel.Widen(1, 2, widened);
+    REQUIRE(widened[0] == 40000);
+    REQUIRE(channel[0] == -40000);
+}
+
+TEST_CASE("trace pyramid", "[trace_pyramid]")
+{
+    const size_t trace_length = 1024;
+    std::vector<int32_t> heights[NucleotideSequence::TRACE_COUNT];
+    for (size_t channel = 0; channel < NucleotideSequence::TRACE_COUNT; ++channel) {
+        for (size_t i = 0; i < trace_length; ++i)
+            heights[channel].push_back(int32_t((i * 37 + channel * 11) % 101) - 50);
+    }
+    static const int32_t peaks[] = { 10, 20, 30, 40 };
+    std::vector<int32_t>::const_iterator begin[NucleotideSequence::TRACE_COUNT], end[NucleotideSequence::TRACE_COUNT];
+    for (size_t channel = 0; channel < NucleotideSequence::TRACE_COUNT; ++channel) {
+        begin[channel] = heights[channel].cbegin();
+        end[channel] = heights[channel].cend();
+    }
+    NucleotideSequence sequence("ACGT");
+    sequence.LoadTraces(peaks + 0, peaks + 4, begin, end);
+
+    // Columns of a power of two samples match the samples exactly.
+    TracePyramid pyramid(sequence);
+    std::vector<TracePyramid::Extent> envelope;
+    pyramid.Envelope(1, 0, trace_length, 16, &envelope);
+    REQUIRE(pyramid.LevelCount() == 11);
+    REQUIRE(envelope.size() == 16);
+    for (size_t p = 0; p < envelope.size(); ++p) {
+        auto column = heights[1].cbegin() + p * 64;
+        REQUIRE(envelope[p].minimum == *std::min_element(column, column + 64));
+        REQUIRE(envelope[p].maximum == *std::max_element(column, column + 64));
+    }
+    pyramid.Envelope(2, 100, 110, 20, &envelope);
+    for (size_t p = 0; p < envelope.size(); ++p)
+        REQUIRE(envelope[p].minimum == heights[2][100 + p / 2]);
+
+    // Changed samples are picked up after invalidating them.
+    heights[1][300] = 1000;
+    heights[1][301] = -1000;
+    sequence.LoadTraces(peaks + 0, peaks + 4, begin, end);
+    pyramid.Invalidate(300, 302);
+    TracePyramid fresh(sequence);
+    std::vector<TracePyramid::Extent> expected;
+    for (size_t pixels : { 3, 16, 100, 1024 }) {
+        pyramid.Envelope(1, 7, trace_length, pixels, &envelope);
+        fresh.Envelope(1, 7, trace_length, pixels, &expected);
+        for (size_t p = 0; p < pixels; ++p) {
+            REQUIRE(envelope[p].minimum == expected[p].minimum);
+            REQUIRE(envelope[p].maximum == expected[p].maximum);
+        }
+    }
+    pyramid.Envelope(1, 0, trace_length, 1, &envelope);
+    REQUIRE(envelope[0].minimum == -1000);
+    REQUIRE(envelope[0].maximum == 1000);
+
+    NucleotideSequence no_traces("ACGT");
+    TracePyramid empty(no_traces);
+    empty.Envelope(0, 0, 100, 4, &envelope);
+    REQUIRE(envelope.size() == 4);
+    REQUIRE(envelope[3].maximum == 0);
+}
+
+TEST_CASE("trace filter", "[trace_filter]")
+{
+    // A ramp on a raised baseline, longer than a block so that blocks must join up.
+    const size_t trace_length = 10000;
+    std::vector<int32_t> input[NucleotideSequence::TRACE_COUNT];
+    for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+        for (size_t i = 0; i < trace_length; ++i)
+            input[c].push_back(int32_t(i + c * 100));
+    }
+    std::vector<int32_t> output[NucleotideSequence::TRACE_COUNT];
+
+    TraceFilter filter;
+    REQUIRE(filter.Empty());
+    filter.Apply(input, output);
+    REQUIRE(output[2] == input[2]);
+
+    // Smoothing keeps a straight line, away from the ends.
+    filter.AddSmoothing(3);
+    REQUIRE(filter.Reach() == 3);
+    filter.Apply(input, output);
+    REQUIRE(output[0].size() == trace_length);
+    for (size_t i = 3; i < trace_length - 3; ++i)
+        REQUIRE(output[1][i] == input[1][i]);
+
+    // A delay of two samples moves each channel along.
+    const float shifts[NucleotideSequence::TRACE_COUNT] = { 0.0f, 2.0f, -2.0f, 0.5f };
+    TraceFilter shift;
+    shift.AddMobilityShift(shifts);
+    shift.Apply(input, output);
+    for (size_t i = 2; i < trace_length - 2; ++i) {
+        REQUIRE(output[0][i] == input[0][i]);
+        REQUIRE(output[1][i] == input[1][i - 2]);
+        REQUIRE(output[2][i] == input[2][i + 2]);
+    }
+    REQUIRE(output[1][0] == input[1][0]);
+
+    // Removing the baseline of a ramp leaves the rise across half the window.
+    TraceFilter baseline;
+    baseline.AddBaselineSubtraction(41);
+    baseline.Apply(input, output);
+    REQUIRE(output[3][5000] == 20);
+    REQUIRE(output[3][4096] == 20);
+    REQUIRE(output[3][0] == 0);
+
+    // Normalization scales the highest channel to the height.
+    baseline.AddNormalization(11, 1000);
+    input[0].assign(100, 20);
+    input[1].assign(100, 40);
+    input[2].clear();
+    input[3].assign(90, 10);
+    baseline.Apply(input, output);
+    REQUIRE(output[2].size() == 100);
+    REQUIRE(output[0][50] == 0);
+
+    TraceFilter normalize;
+    normalize.AddNormalization(11, 1000);
+    normalize.Apply(input, output);
+    REQUIRE(output[1][50] == 1000);
+    REQUIRE(output[0][50] == 500);
+    REQUIRE(output[3][95] == 0);
+
+    // The output loads as traces.
+    NucleotideSequence read("ACGT");
+    static const int32_t peaks[] = { 10, 30, 50, 70 };
+    std::vector<int32_t>::const_iterator begin[NucleotideSequence::TRACE_COUNT], end[NucleotideSequence::TRACE_COUNT];
+    for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+        begin[c] = output[c].cbegin();
+        end[c] = output[c].cend();
+    }
+    read.LoadTraces(peaks + 0, peaks + 4, begin, end);
+    REQUIRE(read.TraceLength() == 100);
+    normalize.Apply(read, output);
+    REQUIRE(output[1][50] == 1000);
+}
+
+TEST_CASE("peak index", "[peak_index]")
+{
+    std::string bases(300, 'A');
+    std::vector<int32_t> peaks;
+    for (size_t i = 0; i < bases.size(); ++i)
+        peaks.push_back(int32_t(i * 10 + 5));
+    std::vector<int32_t> channel(bases.size() * 10, 0);
+    std::vector<int32_t>::const_iterator begin[NucleotideSequence::TRACE_COUNT], end[NucleotideSequence::TRACE_COUNT];
+    for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+        begin[c] = channel.cbegin();
+        end[c] = channel.cend();
+    }
+    NucleotideSequence sequence(bases.c_str());
+    sequence.LoadTraces(peaks.cbegin(), peaks.cend(), begin, end);
+
+    // Compare with a scan of the peaks, the first nearest winning ties.
+    auto check = [&](const PeakIndex& index) {
+        const int32_t* peak = sequence.PeakBegin();
+        for (int32_t sample = -20; sample < int32_t(sequence.Length() * 10 + 20); sample += 3) {
+            size_t nearest = 0;
+            for (size_t i = 1; i < sequence.Length(); ++i) {
+                if (std::abs(peak[i] - sample) < std::abs(peak[nearest] - sample))
+                    nearest = i;
+            }
+            REQUIRE(index.NearestBase(sample) == nearest);
+        }
+    };
+    PeakIndex index(sequence);
+    check(index);
+    size_t first = 0, last = 0;
+    REQUIRE(index.BasesInWindow(100, 130, &first, &last));
+    REQUIRE(first == 10);
+    REQUIRE(last == 12);
+    REQUIRE(!index.BasesInWindow(101, 104, &first, &last));
+
+    // Out of order peaks after edits.
+    sequence.Replace(50, 1, 'C', 40, 2000);
+    index.Update(50, 1, 1);
+    check(index);
+    REQUIRE(index.NearestBase(2000) == 50);
+    REQUIRE(index.BasesInWindow(1990, 2010, &first, &last));
+    REQUIRE(first == 50);
+    REQUIRE(last == 200);
+    sequence.DeleteSubsequence(20, 30);
+    index.Update(20, 30, 0);
+    check(index);
+    REQUIRE(index.NearestBase(2000) == 20);
+    for (size_t i = 0; i < 300; ++i) {
+        sequence.Replace(100, 0, 'G', 40, 7);
+        index.Update(100, 0, 1);
+    }
+    check(index);
+
+    // Bases beyond the last peak have none.
+    NucleotideSequence short_peaks(bases.c_str());
+    short_peaks.LoadTraces(peaks.cbegin(), peaks.cbegin() + 100, begin, end);
+    PeakIndex partial(short_peaks);
+    REQUIRE(partial.NearestBase(2500) == 99);
+    REQUIRE(partial.BasesInWindow(980, 2000, &first, &last));
+    REQUIRE(first == 98);
+    REQUIRE(last == 99);
+    short_peaks.Replace(50, 1, 'C', 40, 3000);
+    partial.Update(50, 1, 1);
+    REQUIRE(partial.NearestBase(2500) == 50);
+
+    NucleotideSequence no_traces("ACGT");
+    PeakIndex empty(no_traces);
+    REQUIRE(empty.NearestBase(10) == size_t(PeakIndex::NOT_FOUND));
+    REQUIRE(!empty.BasesInWindow(0, 100, &first, &last));
+}
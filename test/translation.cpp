@@ -17,8 +17,12 @@
 // You should have received a copy of the GNU General Public License
 // along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
 
+#include <cmath>
 #include "catch_amalgamated.hpp"
 #include "geneticcodes.h"
+#include "translationcache.h"
+#include "orffinder.h"
+#include "codonusage.h"
 
 // TCAG
 static const char standard_code[] = "FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG";
@@ -74,6 +78,12 @@ TEST_CASE("Codon translation", "[translation]")
     codon = GeneticCodes::TranslateForward("HTG", 0, 3, 0); // (T/C/A)TG
     REQUIRE(codon.amino_acid == 'X');
     REQUIRE(codon.can_start == true);
+    // A gap matches no base, so a codon containing one is unknown rather than taking the amino acid of TTT.
+    codon = GeneticCodes::TranslateForward("A-G", 0, 3, 0);
+    REQUIRE(codon.amino_acid == 'X');
+    REQUIRE(codon.can_start == false);
+    codon = GeneticCodes::TranslateReverseComplement("TT-", 0, 3, 0);
+    REQUIRE(codon.amino_acid == 'X');
 
     char leucine[] = "CTN";
     static const char redundant[] = "BDHKMRSVWY";
@@ -83,4 +93,214 @@ TEST_CASE("Codon translation", "[translation]")
 		REQUIRE(codon.amino_acid == 'L');
 		REQUIRE(codon.can_start == false);
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Bulk translation", "[translation]")
+{
+    static const char bases[] = "ACGTACGTACGTNRYSWKMBDHV";
+    std::string seq;
+    for (size_t i = 0; i < 5000; ++i)
+        seq.push_back(bases[(i * 7919 + i / 13) % (sizeof(bases) - 1)]);
+
+    for (size_t start = 0; start < 3; ++start) {
+        size_t end = seq.length() - start;
+        std::vector<char> amino_acids((end - start) / 3);
+        REQUIRE(GeneticCodes::Translate(seq.c_str(), start, end, false, 0, amino_acids.data()) == amino_acids.size());
+        for (size_t i = 0; i < amino_acids.size(); ++i)
+            REQUIRE(amino_acids[i] == GeneticCodes::TranslateForward(seq.c_str(), start + i * 3, end, 0).amino_acid);
+
+        REQUIRE(GeneticCodes::Translate(seq.c_str(), start, end, true, 0, amino_acids.data()) == amino_acids.size());
+        for (size_t i = 0; i < amino_acids.size(); ++i)
+            REQUIRE(amino_acids[i] == GeneticCodes::TranslateReverseComplement(seq.c_str(), end - (i + 1) * 3, end, 0).amino_acid);
+    }
+
+    char protein[2];
+    REQUIRE(GeneticCodes::Translate("ATGTGGCA", 0, 8, false, 0, protein) == 2);
+    REQUIRE(std::string(protein, 2) == "MW");
+    REQUIRE(GeneticCodes::Translate("TTGCCCAT", 0, 8, true, 0, protein) == 2);
+    REQUIRE(std::string(protein, 2) == "MG");
+}
+
+TEST_CASE("Six frame translation cache", "[translation]")
+{
+    static const char bases[] = "ACGTACGTACGTNRY";
+    std::string seq;
+    for (size_t i = 0; i < 300; ++i)
+        seq.push_back(bases[(i * 7919 + i / 7) % (sizeof(bases) - 1)]);
+    NucleotideSequence sequence(seq.c_str());
+    TranslationCache cache(sequence, GeneticCodes::STANDARD);
+
+    for (size_t edit = 0; edit < 60; ++edit) {
+        size_t pos = (edit * 97) % (sequence.Length() + 1);
+        size_t old_length = std::min<size_t>(edit % 5, sequence.Length() - pos);
+        std::string insert;
+        for (size_t i = 0; i < (edit * 3) % 7; ++i)
+            insert.push_back(bases[(edit + i) % (sizeof(bases) - 1)]);
+        if (edit % 3 == 0) {
+            sequence.DeleteSubsequence(pos, old_length);
+            cache.Update(pos, old_length, 0);
+        }
+        else {
+            sequence.Replace(pos, old_length, NucleotideSequence(insert.c_str()));
+            cache.Update(pos, old_length, insert.length());
+        }
+
+        TranslationCache expected(sequence, GeneticCodes::STANDARD);
+        for (size_t frame = 0; frame < TranslationCache::FRAME_COUNT; ++frame) {
+            REQUIRE(cache.Frame(frame, false) == expected.Frame(frame, false));
+            REQUIRE(cache.Frame(frame, true) == expected.Frame(frame, true));
+        }
+    }
+
+    NucleotideSequence orf("ATGTGGTAA");
+    TranslationCache orf_cache(orf, GeneticCodes::STANDARD);
+    REQUIRE(orf_cache.Frame(0, false) == "MW*");
+    REQUIRE(orf_cache.Frame(0, true) == "HPL");
+}
+
+// ORFs of one strand, translating codon by codon.
+static void FindOrfsSlow(const std::string& seq, size_t min_codons, bool alternative_starts, bool reverse, std::vector<OrfFinder::Orf>* orfs)
+{
+    for (size_t frame = 0; frame < 3; ++frame) {
+        size_t count = seq.length() > frame ? (seq.length() - frame) / 3 : 0;
+        size_t frame_end = frame + count * 3;
+        size_t open = (size_t)-1;
+        for (size_t k = 0; k < count; ++k) {
+            GeneticCodes::Codon codon = reverse
+                ? GeneticCodes::TranslateReverseComplement(seq.c_str(), frame_end - 3 * (k + 1), seq.length(), 0)
+                : GeneticCodes::TranslateForward(seq.c_str(), frame + 3 * k, seq.length(), 0);
+            if (open == (size_t)-1 && codon.can_start && (alternative_starts || codon.amino_acid == 'M'))
+                open = k;
+            if (codon.amino_acid == '*') {
+                if (open != (size_t)-1 && k - open >= min_codons) {
+                    if (reverse)
+                        orfs->push_back({ frame_end - 3 * (k + 1), frame_end - 3 * open, true });
+                    else
+                        orfs->push_back({ frame + 3 * open, frame + 3 * (k + 1), false });
+                }
+                open = (size_t)-1;
+            }
+        }
+    }
+}
+
+TEST_CASE("ORF finder", "[orf]")
+{
+    // Long enough for several chunks, with a stop-free ORF spanning chunk boundaries.
+    std::string seq;
+    for (size_t i = 0; i < 400000; ++i)
+        seq.push_back("ACGTACGTACGTN"[(i * 7919 + i / 11 + i / 1013) % 13]);
+    std::string long_orf = "ATG";
+    for (size_t i = 0; i < 150000; ++i)
+        long_orf += "GCT";
+    long_orf += "TAA";
+    seq.insert(100001, long_orf);
+    NucleotideSequence sequence(seq.c_str());
+
+    for (int alternative_starts = 0; alternative_starts < 2; ++alternative_starts) {
+        for (size_t min_codons : { 0, 30 }) {
+            std::vector<OrfFinder::Orf> orfs;
+            OrfFinder::Find(sequence, GeneticCodes::STANDARD, min_codons, alternative_starts != 0, &orfs);
+            std::vector<OrfFinder::Orf> expected;
+            FindOrfsSlow(seq, min_codons, alternative_starts != 0, false, &expected);
+            FindOrfsSlow(seq, min_codons, alternative_starts != 0, true, &expected);
+            REQUIRE(orfs.size() == expected.size());
+            std::sort(expected.begin(), expected.end(), [](const OrfFinder::Orf& x, const OrfFinder::Orf& y) {
+                return x.start < y.start || (x.start == y.start && x.end < y.end);
+            });
+            for (size_t i = 0; i < orfs.size(); ++i) {
+                REQUIRE(orfs[i].start == expected[i].start);
+                REQUIRE(orfs[i].end == expected[i].end);
+                REQUIRE(orfs[i].reverse == expected[i].reverse);
+            }
+            bool found = std::any_of(orfs.cbegin(), orfs.cend(), [](const OrfFinder::Orf& orf) {
+                return orf.start <= 100001 && orf.end == 100001 + 3 + 450000 + 3 && !orf.reverse;
+            });
+            REQUIRE(found);
+        }
+    }
+
+    std::vector<OrfFinder::Orf> orfs;
+    OrfFinder::Find(NucleotideSequence("CCATGAAATAGTTACATCCC"), GeneticCodes::STANDARD, 1, false, &orfs);
+    REQUIRE(orfs.size() == 2);
+    REQUIRE(orfs[0].start == 2);
+    REQUIRE(orfs[0].end == 11);
+    REQUIRE(!orfs[0].reverse);
+    REQUIRE(orfs[1].start == 11);
+    REQUIRE(orfs[1].end == 17);
+    REQUIRE(orfs[1].reverse);
+}
+
+TEST_CASE("Built-in genetic codes", "[translation]")
+{
+    REQUIRE(GeneticCodes::Search("Standard") == 0);
+    size_t count = 0;
+    for (auto it = GeneticCodes::cbegin(); it != GeneticCodes::cend(); ++it)
+        ++count;
+    REQUIRE(count == 27);
+
+    int mitochondrial = GeneticCodes::Search("Vertebrate Mitochondrial");
+    REQUIRE(mitochondrial > 0);
+    REQUIRE(GeneticCodes::TranslateForward("AGA", 0, 3, mitochondrial).amino_acid == '*');
+    REQUIRE(GeneticCodes::TranslateForward("TGA", 0, 3, mitochondrial).amino_acid == 'W');
+    REQUIRE(GeneticCodes::TranslateForward("ATA", 0, 3, mitochondrial).can_start);
+    REQUIRE(GeneticCodes::TranslateForward("AGR", 0, 3, mitochondrial).amino_acid == '*');
+    REQUIRE(GeneticCodes::TranslateForward("AGA", 0, 3, GeneticCodes::STANDARD).amino_acid == 'R');
+}
+
+TEST_CASE("Codon usage", "[translation]")
+{
+    NucleotideSequence sequence("ATGGCTGCCGCCAAATAA");
+    CodonUsage usage;
+    usage.Add(sequence, 0, sequence.Length(), false);
+    REQUIRE(usage.TotalCodons() == 6);
+    REQUIRE(usage.AmbiguousCodons() == 0);
+    REQUIRE(usage.CodonCount("GCC") == 2);
+    REQUIRE(usage.CodonCount("GCU") == 1);
+    REQUIRE(usage.GC3() == 0.5);
+
+    CodonUsage::Composition composition;
+    REQUIRE(usage.AminoAcidComposition(GeneticCodes::STANDARD, &composition));
+    REQUIRE(composition[LookupTables::CharIndex('A')] == 3);
+    REQUIRE(composition[LookupTables::CharIndex('M')] == 1);
+    REQUIRE(composition[LookupTables::CharIndex('K')] == 1);
+    REQUIRE(composition[CodonUsage::STOP_INDEX] == 1);
+    REQUIRE(!usage.AminoAcidComposition(1000, &composition));
+
+    // Against itself: GCT has half the usage of GCC, Met and the stop are not scored.
+    REQUIRE(usage.Cai(usage, GeneticCodes::STANDARD) == Catch::Approx(std::pow(0.5, 0.25)));
+
+    CodonUsage reverse;
+    reverse.Add(NucleotideSequence("GTTATTTGGCGGCAGCCATG"), 1, 19, true);
+    for (const char* codon : { "ATG", "GCT", "GCC", "AAA", "TAA", "TTA" })
+        REQUIRE(reverse.CodonCount(codon) == usage.CodonCount(codon));
+
+    // Codons containing gaps or ambiguous bases count as unknown amino acids, except where the code makes them definite.
+    CodonUsage ambiguous;
+    ambiguous.Add(NucleotideSequence("GCNA-AAAR"), 0, 9, false);
+    REQUIRE(ambiguous.AmbiguousCodons() == 3);
+    REQUIRE(ambiguous.AminoAcidComposition(GeneticCodes::STANDARD, &composition));
+    REQUIRE(composition[LookupTables::CharIndex('A')] == 1);
+    REQUIRE(composition[LookupTables::CharIndex('K')] == 1);
+    REQUIRE(composition[LookupTables::CharIndex('X')] == 1);
+
+    // Counting a collection in parallel gives the same totals as counting serially.
+    std::string seq;
+    unsigned int random = 1;
+    for (size_t i = 0; i < 2000000; ++i) {
+        random = random * 1103515245 + 12345;
+        seq += "ACGT"[(random >> 16) & 3];
+    }
+    NucleotideSequence large(seq.c_str());
+    std::vector<CodonUsage::Region> regions = { { &large, 1, large.Length(), false }, { &large, 0, 1000000, true }, { &sequence, 0, 18, false } };
+    CodonUsage serial;
+    for (auto& region : regions)
+        serial.Add(*region.sequence, region.start, region.end, region.reverse_complement);
+    CodonUsage parallel;
+    CodonUsage::Count(regions, &parallel);
+    REQUIRE(parallel.TotalCodons() == serial.TotalCodons());
+    for (size_t i = 0; i < 64; ++i) {
+        char codon[] = { "TCAG"[i >> 4], "TCAG"[(i >> 2) & 3], "TCAG"[i & 3], 0 };
+        REQUIRE(parallel.CodonCount(codon) == serial.CodonCount(codon));
+    }
+    REQUIRE(parallel.Cai(usage, GeneticCodes::STANDARD) == Catch::Approx(serial.Cai(usage, GeneticCodes::STANDARD)));
+}
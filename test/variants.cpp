@@ -0,0 +1,150 @@
+// Tests for variant calling.
+//
+// Copyright 2022 Conor N. McCarthy
+//
+// This file is part of Chromas 3.
+//
+// Chromas 3 is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Chromas 3 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Chromas 3. If not, see < https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include "catch_amalgamated.hpp"
+#include "variants.h"
+
+static const size_t PEAK_SPACING = 10;
+
+// Make a read with a clean peak for each base, and a secondary peak of the given height at het_position. Only the first
+// peak_count peaks are kept.
+static std::unique_ptr<NucleotideSequence> MakeRead(const std::string& bases, size_t het_position, char het_base, int het_height, size_t peak_count = std::string::npos)
+{
+    auto read = std::make_unique<NucleotideSequence>(bases.c_str());
+    std::vector<NucleotideSequence::peak_type> peaks;
+    std::vector<NucleotideSequence::trace_type> channels[NucleotideSequence::TRACE_COUNT];
+    for (auto& channel : channels)
+        channel.assign(bases.length() * PEAK_SPACING, 10);
+    for (size_t i = 0; i < bases.length(); ++i) {
+        size_t peak = i * PEAK_SPACING + PEAK_SPACING / 2;
+        peaks.push_back(NucleotideSequence::peak_type(peak));
+        channels[std::string("ACGT").find(bases[i])][peak] = 1000;
+        if (i == het_position)
+            channels[std::string("ACGT").find(het_base)][peak + 1] = het_height;
+    }
+    const NucleotideSequence::trace_type* begins[NucleotideSequence::TRACE_COUNT];
+    const NucleotideSequence::trace_type* ends[NucleotideSequence::TRACE_COUNT];
+    for (size_t c = 0; c < NucleotideSequence::TRACE_COUNT; ++c) {
+        begins[c] = channels[c].data();
+        ends[c] = channels[c].data() + channels[c].size();
+    }
+    read->LoadTraces(peaks.cbegin(), peaks.cbegin() + std::min(peak_count, peaks.size()), begins, ends);
+    return read;
+}
+
+TEST_CASE("Variant calling", "[variants]")
+{
+    std::mt19937 rng(30);
+    std::string reference_bases;
+    for (size_t i = 0; i < 400; ++i)
+        reference_bases.push_back("ACGT"[rng() & 3]);
+    NucleotideSequence reference(reference_bases.c_str());
+
+    // Reads cover part of the reference, with an SNV at reference position 150 and a heterozygote at 200.
+    std::string bases = reference_bases.substr(100, 200);
+    bases[50] = bases[50] == 'A' ? 'C' : 'A';
+    char het_base = bases[100] == 'G' ? 'T' : 'G';
+
+    std::vector<std::unique_ptr<NucleotideSequence>> reads;
+    reads.push_back(MakeRead(bases, 100, het_base, 600));
+    reads.push_back(MakeRead(bases, 100, het_base, 100));
+    reads.push_back(std::make_unique<NucleotideSequence>(bases.c_str()));
+    std::vector<const NucleotideSequence*> pointers;
+    for (auto& read : reads)
+        pointers.push_back(read.get());
+
+    std::vector<VariantCaller::Call> calls[3];
+    VariantCaller::CallVariants(reference, pointers.data(), pointers.size(), 30, 0, calls);
+
+    // A secondary peak at 60% of the primary is called; one at 10% is not.
+    REQUIRE(calls[0].size() == 2);
+    REQUIRE(calls[0][0].type == VariantCaller::Type::SNV);
+    REQUIRE(calls[0][0].position == 150);
+    REQUIRE(calls[0][0].read_position == 50);
+    REQUIRE(calls[0][0].call == bases[50]);
+    REQUIRE(calls[0][1].type == VariantCaller::Type::HETEROZYGOTE);
+    REQUIRE(calls[0][1].position == 200);
+    REQUIRE(calls[0][1].secondary_percent == 60);
+    REQUIRE((LookupTables::BaseFlags(calls[0][1].call) == (LookupTables::BaseFlags(bases[100]) | LookupTables::BaseFlags(het_base))));
+
+    REQUIRE(calls[1].size() == 1);
+    REQUIRE(calls[1][0].type == VariantCaller::Type::SNV);
+
+    // Without traces only the SNV can be found.
+    REQUIRE(calls[2].size() == 1);
+    REQUIRE(calls[2][0].position == 150);
+
+    // Positions beyond the last peak have no secondary peak, but can still be SNVs.
+    auto partial = MakeRead(bases, 100, het_base, 600, 150);
+    std::vector<VariantCaller::Call> partial_calls;
+    REQUIRE(VariantCaller::CallVariants(reference, *partial, 30, 0, &partial_calls));
+    REQUIRE(partial_calls.size() == 2);
+    REQUIRE(partial_calls[1].type == VariantCaller::Type::HETEROZYGOTE);
+    partial = MakeRead(bases, 100, het_base, 600, 80);
+    REQUIRE(VariantCaller::CallVariants(reference, *partial, 30, 0, &partial_calls));
+    REQUIRE(partial_calls.size() == 1);
+    REQUIRE(partial_calls[0].type == VariantCaller::Type::SNV);
+    REQUIRE(partial_calls[0].secondary_percent == 1);
+
+    // Low quality calls are dropped.
+    std::vector<VariantCaller::Call> filtered;
+    REQUIRE(VariantCaller::CallVariants(reference, *reads[0], 30, NucleotideSequence::DEFAULT_BASE_QUALITY + 1, &filtered));
+    REQUIRE(filtered.empty());
+}
+
+TEST_CASE("Secondary peaks", "[variants]")
+{
+    std::string bases = "ACGTACGTTGCA";
+    std::vector<std::unique_ptr<NucleotideSequence>> reads;
+    reads.push_back(MakeRead(bases, 5, 'A', 600));
+    reads.push_back(std::make_unique<NucleotideSequence>(bases.c_str()));
+    std::vector<const NucleotideSequence*> pointers;
+    for (auto& read : reads)
+        pointers.push_back(read.get());
+
+    std::vector<VariantCaller::SecondaryPeak> peaks[2];
+    VariantCaller::SecondaryPeaks(pointers.data(), pointers.size(), 30, peaks);
+    REQUIRE(peaks[0].size() == bases.length());
+    REQUIRE(peaks[1].empty());
+
+    // Clean peaks keep their base; the secondary A peak at 60% makes the C at position 5 an M.
+    REQUIRE(peaks[0][0].called_channel == 0);
+    REQUIRE(peaks[0][0].heights[0] == 1000);
+    REQUIRE(peaks[0][0].secondary_percent == 1);
+    REQUIRE(peaks[0][0].call == 'A');
+    REQUIRE(peaks[0][5].called_channel == 1);
+    REQUIRE(peaks[0][5].secondary_channel == 0);
+    REQUIRE(peaks[0][5].secondary_percent == 60);
+    REQUIRE(peaks[0][5].call == 'M');
+
+    std::vector<VariantCaller::SecondaryPeak> unrecalled;
+    REQUIRE(VariantCaller::SecondaryPeaks(*reads[0], 0, &unrecalled));
+    REQUIRE(unrecalled[5].call == 'C');
+    REQUIRE(!VariantCaller::SecondaryPeaks(*reads[1], 30, &unrecalled));
+
+    // Bases beyond the last peak are left out.
+    auto partial = MakeRead(bases, 5, 'A', 600, 8);
+    REQUIRE(VariantCaller::SecondaryPeaks(*partial, 30, &unrecalled));
+    REQUIRE(unrecalled.size() == 8);
+    REQUIRE(unrecalled[5].call == 'M');
+}
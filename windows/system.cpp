@@ -38,6 +38,18 @@ static size_t WideCharToMultiByte(const wchar_t* src, std::string& dst)
 	return dst_len;
 }
 
+static std::wstring MultiByteToWideChar(const char* src)
+{
+	std::wstring dst;
+	int src_len = (int)strlen(src);
+	int dst_len = MultiByteToWideChar(CP_UTF8, 0, src, src_len, nullptr, 0);
+	if (dst_len) {
+		dst.resize(dst_len);
+		MultiByteToWideChar(CP_UTF8, 0, src, src_len, &dst[0], dst_len);
+	}
+	return dst;
+}
+
 std::string System::ProgramDataDir()
 {
     PWSTR path = nullptr;
@@ -56,3 +68,25 @@ void System::AppendName(std::string& path, const char* name)
         path.push_back('\\');
     path.append(name);
 }
+
+bool System::ListDirectory(const char* path, std::vector<std::string>& names)
+{
+    names.clear();
+    std::wstring pattern = MultiByteToWideChar(path);
+    if (pattern.empty() || (pattern.back() != L'\\' && pattern.back() != L'/'))
+        pattern.push_back(L'\\');
+    pattern.push_back(L'*');
+
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileW(pattern.c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            names.emplace_back();
+            WideCharToMultiByte(data.cFileName, names.back());
+        }
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    return true;
+}